@@ -0,0 +1,16 @@
+#pragma once
+
+#include "types.h"
+#include "quadtree.h"
+
+
+/* label of DBSCAN's noise points */
+#define CLUSTER_NOISE ((size_t)-1)
+
+
+size_t cluster_fof( const Node *, const Item *, size_t, double, unsigned int,
+                    size_t * );
+size_t cluster_dbscan( const Node *, const Item *, size_t, double, size_t,
+                       unsigned int, size_t * );
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include "types.h"
+#include "query.h"
+
+
+/* struct filter_ws_t
+ * workspace of filter_radius, reused over consecutive queries: the values of
+ * the candidates are gathered in structure-of-arrays layout, so that the
+ * distances of several candidates are computed by one vector instruction
+ *
+ * Members
+ * =======
+ * x, y, int16_t * :   coordinates of the candidates
+ * size, size_t    :   available size of x and y
+ *
+ */
+typedef struct filter_ws_s {
+    int16_t *x, *y;
+    size_t size;
+} filter_ws_t;
+
+
+void filter_init( filter_ws_t * );
+void filter_free( filter_ws_t * );
+size_t filter_radius( const Value *, const DArray_Item *, double,
+                      filter_ws_t *, DArray_Item * );
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
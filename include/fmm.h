@@ -0,0 +1,80 @@
+#pragma once
+
+#include <complex.h>
+#include "types.h"
+#include "quadtree.h"
+
+
+/* NOTICE: the fast multipole method solves the 2D logarithmic potential
+ * (forces ~ 1/r, no softening), which is a different force law than the
+ * softened 1/r^2 of bh_accel; compare it with direct_accel_log only.
+ */
+
+
+/* struct fcell_t
+ * node of the tree, as seen by the fast multipole method: subtrees with few
+ * items are cut off, their items are gathered into the leaf
+ *
+ * Members
+ * =======
+ * z, double complex   :   centre of expansions, i.e. of the node's cell
+ * r, double           :   largest distance of an item from z
+ * b, e, size_t        :   items of the subtree are fmm_t.it[b ... e-1]
+ * c, size_t[NOC]      :   indices of children in fmm_t.cells (0: none)
+ * front, uint8_t      :   whether the cell is part of the frontier, i.e.
+ *                         the topmost cells with few enough items, whose
+ *                         subtrees are processed in parallel
+ *
+ */
+typedef struct fcell_s {
+    double complex z;
+    double r;
+    size_t b, e;
+    size_t c[NOC];
+    uint8_t front;
+} fcell_t;
+
+
+/* struct fmm_t
+ * fast multipole method on the nodes of a tree: every node, which is kept
+ * (see fcell_t), gets a multipole and a local expansion
+ *
+ * Members
+ * =======
+ * head, Node *            :   root of tree
+ * mass, double *          :   masses by original index (NULL means 1)
+ * size, size_t            :   number of items
+ * order, unsigned int     :   number of terms of the expansions
+ * leaf, size_t            :   nodes with at most that many items are leaves
+ * cells, fcell_t *        :   kept nodes in depth-first order, root first
+ * ncells, size_t          :   number of cells
+ * it, Item **             :   items in depth-first (i.e. Morton) order
+ * front, size_t *         :   cells of the frontier, see fcell_t
+ * nfront, size_t          :   number of cells of the frontier
+ * me, le, double complex *:   multipole and local expansion of each cell,
+ *                             order+1 coefficients each
+ * binom, double *         :   binomial coefficients up to 2*order
+ *
+ */
+typedef struct fmm_s {
+    const Node *head;
+    const double *mass;
+    size_t size;
+    unsigned int order;
+    size_t leaf;
+    fcell_t *cells;
+    size_t ncells;
+    const Item **it;
+    size_t *front, nfront;
+    double complex *me, *le;
+    double *binom;
+} fmm_t;
+
+
+void fmm_init( fmm_t *, const Node *, const double *, unsigned int, size_t );
+void fmm_accel( fmm_t *, unsigned int, double *, double * );
+void fmm_free( fmm_t * );
+void direct_accel_log( const Value *, const double *, size_t, double *,
+                       double * );
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
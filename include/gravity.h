@@ -0,0 +1,52 @@
+#pragma once
+
+#include "types.h"
+#include "quadtree.h"
+
+
+/* struct bcell_t
+ * node of the tree with its multipole moment (monopole)
+ *
+ * Members
+ * =======
+ * node, Node *        :   node of the tree
+ * m, double           :   mass of the node's subtree
+ * cx, cy, double      :   centre of mass of the node's subtree
+ * c, size_t[NOC]      :   indices of children in bh_t.cells (0: none)
+ *
+ */
+typedef struct bcell_s {
+    const Node *node;
+    double m, cx, cy;
+    size_t c[NOC];
+} bcell_t;
+
+
+/* struct bh_t
+ * multipole moments of the nodes of a tree for Barnes-Hut
+ *
+ * Members
+ * =======
+ * head, Node *        :   root of tree
+ * mass, double *      :   masses by original index (Item.idx); NULL means 1
+ * cells, bcell_t *    :   nodes in depth-first order, root first
+ * ncells, size_t      :   number of cells
+ *
+ */
+typedef struct bh_s {
+    const Node *head;
+    const double *mass;
+    bcell_t *cells;
+    size_t ncells;
+} bh_t;
+
+
+void bh_init( bh_t *, const Node *, const double * );
+void bh_update( bh_t * );
+void bh_accel( const bh_t *, const Item *, size_t, double, double,
+               unsigned int, double *, double * );
+void bh_free( bh_t * );
+void direct_accel( const Value *, const double *, size_t, double, double *,
+                   double * );
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "types.h"
+#include "quadtree.h"
+#include "query.h"
+
+
+/* struct CSR
+ * neighbour lists of all items in compressed sparse row format
+ *
+ * Members
+ * =======
+ * n, size_t           :   number of rows, i.e. of items
+ * offsets, size_t *   :   array of size n+1; the neighbours of the item with
+ *                         original index i are
+ *                             indices[offsets[i]], ..., indices[offsets[i+1]-1]
+ * indices, size_t *   :   array of size offsets[n]; original indices (Item.idx)
+ *                         of the neighbours
+ *
+ */
+typedef struct CSR {
+    size_t n;
+    size_t *offsets;
+    size_t *indices;
+} CSR;
+
+
+void pairs_radius( const Node *, const Item *, size_t, double, int, CSR * );
+void pairs_radius_concurrent( const Node *, const Item *, size_t, double, int,
+                              unsigned int, CSR * );
+void pairs_dualtree( const Node *, size_t, double, int, CSR * );
+void csr_free( CSR * );
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
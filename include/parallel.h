@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stddef.h>
+
+/* signature of tasks passed to parallel_for:
+ *     void task( size_t begin, size_t end, unsigned int tid, void *ctx )
+ * process indices in [begin, end); tid is the index of the calling thread
+ * (0 <= tid < nthreads), e.g. to select thread-local buffers */
+typedef void (*task_fptr_t)(size_t, size_t, unsigned int, void *);
+
+unsigned int num_threads( unsigned int );
+void parallel_for( size_t, size_t, unsigned int, task_fptr_t, void * );
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -10,12 +10,54 @@
 #define MASK 0x3
 
 
+/* statistics returned by refit */
+typedef struct refit_stats_s {
+    size_t moved;       /* number of items, which left their leaf */
+    size_t touched;     /* number of vacated, reused or created nodes */
+} refit_stats_t;
+
+
+/* path_t
+ * nodes on the path of the last search_path, which are reused by the next
+ * one as far as its key shares the prefix (the tree must not be modified
+ * in between, otherwise call path_init again)
+ *
+ * Members
+ * =======
+ * n, Node *[]     :   n[l] is the node on level l, for lo <= l <= hi
+ * lo, hi, lvl_t   :   level of the root and of the last found node
+ * lookups, size_t :   number of searches
+ * hits, size_t    :   number of searches not starting at the root
+ *
+ */
+typedef struct path_s {
+    Node *n[MAXLVL+1];
+    lvl_t lo, hi;
+    size_t lookups, hits;
+} path_t;
+
+
 Node *build_tree( const Item *, lvl_t (*)(Node *, const Item *) );
+Node *build_tree_concurrent( const Item *, size_t, unsigned int );
 void cleanup( Node * );
+size_t count_items( Node * );
 
 lvl_t insert_fast( Node *, const Item * );
 lvl_t insert_simple( Node *, const Item * );
+lvl_t insert_concurrent( Node *, const Item * );
+void refit( Node *, Item *, refit_stats_t * );
 Node *search( key_t , Node *, lvl_t );
 void find_neighbours( key_t , Node *, DArray_Item * );
 
+void path_init( path_t *, Node * );
+Node *search_path( key_t , path_t *, lvl_t );
+void find_neighbours_path( key_t , path_t *, DArray_Item * );
+
+Node **index_leaves( Node *, const Item *, size_t );
+void find_neighbours_leaf( Node *, Node *, DArray_Item * );
+void find_neighbours_periodic( key_t , Node *, DArray_Item * );
+Node *locate( const Value *, Node * );
+void find_neighbours_point( const Value *, Node *, DArray_Item * );
+void find_neighbours_ring( key_t , Node *, double, lvl_t, DArray_Item * );
+
 /* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
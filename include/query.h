@@ -0,0 +1,146 @@
+#pragma once
+
+#include "types.h"
+#include "morton.h"
+#include "quadtree.h"
+
+#define SQUARE(x) (x)*(x)
+#define SD(v, w, a) SQUARE((v)->a - (w)->a)         /* squared difference */
+#define METRIC(v, w) (SD(v, w, x) + SD(v, w, y))
+/* minimum image convention in the periodic domain [0, 256)^2 */
+#define PDIFF(v, w, a) ((v)->a > (w)->a ? (v)->a - (w)->a : (w)->a - (v)->a)
+#define PSD(v, w, a) SQUARE(PDIFF(v, w, a) < 128 ? PDIFF(v, w, a) \
+                                                 : 256 - PDIFF(v, w, a))
+#define METRIC_PERIODIC(v, w) (PSD(v, w, x) + PSD(v, w, y))
+
+
+void find_radius( const Value *, double, const Node *, DArray_Item * );
+void range_query( const Node *, lvl_t, lvl_t, lvl_t, lvl_t, DArray_Item * );
+size_t count_radius( const Value *, double, const Node * );
+size_t count_range( const Node *, lvl_t, lvl_t, lvl_t, lvl_t );
+size_t knn( const Node *, const Value *, size_t, size_t *, double * );
+void knn_all( const Node *, const Item *, size_t, size_t, size_t *, double * );
+size_t knn_approx( const Node *, const Value *, size_t, double, size_t,
+                   size_t *, double *, double * );
+
+
+/********************************************************************/
+/* Implementation of static inline helpers                          */
+/********************************************************************/
+
+/* The cell of a node on level l with key k covers the values
+ *     x0 <= x < x0 + 256 / 2^l,   y0 <= y < y0 + 256 / 2^l,
+ * where (x0, y0) = coords2( k << DIM*(maxlvl - l) ).
+ */
+
+/* cell
+ * get origin and edge length of given node's cell
+ *
+ * Params
+ * ======
+ * n, Node *       :   node of which to get the cell
+ * o, Value *      :   origin (lowest x and y) is written into it
+ *
+ * Returns
+ * =======
+ * edge length, i.e. number of values per dimension
+ *
+ */
+static inline unsigned int cell( const Node *n, Value *o )
+{
+    *o = coords2( n->key << DIM * (maxlvl - n->lvl) );
+    return 256u >> n->lvl;
+}
+
+
+/* mind, maxd - minimal and maximal squared distance between a value and the
+ * values inside of a cell
+ *
+ * Params
+ * ======
+ * q, Value *          :   query value
+ * o, Value *          :   origin of cell
+ * len, unsigned int   :   edge length of cell
+ *
+ */
+static inline double mind( const Value *q, const Value *o, unsigned int len )
+{
+    int dx, dy;
+    dx = (q->x < o->x) ? o->x - q->x
+       : (q->x > o->x + (int)len - 1) ? q->x - (o->x + (int)len - 1) : 0;
+    dy = (q->y < o->y) ? o->y - q->y
+       : (q->y > o->y + (int)len - 1) ? q->y - (o->y + (int)len - 1) : 0;
+    return SQUARE(dx) + SQUARE(dy);
+}
+
+static inline double maxd( const Value *q, const Value *o, unsigned int len )
+{
+    int dx, dy;
+    dx = q->x - o->x;
+    dx = (dx > (int)len - 1 - dx) ? dx : (int)len - 1 - dx;
+    dy = q->y - o->y;
+    dy = (dy > (int)len - 1 - dy) ? dy : (int)len - 1 - dy;
+    return SQUARE(dx) + SQUARE(dy);
+}
+
+
+/* child_cell
+ * get origin and edge length of the cell of a node's child (children are
+ * always one level deeper than their parent), avoiding to decode its key
+ *
+ * Params
+ * ======
+ * o, Value *          :   origin of parent's cell
+ * len, unsigned int   :   edge length of parent's cell
+ * i, uint8_t          :   index of child, i.e. y << 1 | x
+ * co, Value *         :   origin of child's cell is written into it
+ *
+ * Returns
+ * =======
+ * edge length of child's cell
+ *
+ */
+static inline unsigned int child_cell( const Value *o, unsigned int len,
+                                       uint8_t i, Value *co )
+{
+    len /= 2;
+    co->x = o->x + ((i & 1) ? len : 0);
+    co->y = o->y + ((i & 2) ? len : 0);
+    return len;
+}
+
+
+/* mind_cells, maxd_cells - minimal and maximal squared distance between the
+ * values of two cells
+ *
+ * Params
+ * ======
+ * oa, ob, Value *         :   origins of cells
+ * la, lb, unsigned int    :   edge lengths of cells
+ *
+ */
+static inline double mind_cells( const Value *oa, unsigned int la,
+                                 const Value *ob, unsigned int lb )
+{
+    int dx, dy;
+    dx = (oa->x + (int)la <= ob->x) ? ob->x - (oa->x + (int)la - 1)
+       : (ob->x + (int)lb <= oa->x) ? oa->x - (ob->x + (int)lb - 1) : 0;
+    dy = (oa->y + (int)la <= ob->y) ? ob->y - (oa->y + (int)la - 1)
+       : (ob->y + (int)lb <= oa->y) ? oa->y - (ob->y + (int)lb - 1) : 0;
+    return SQUARE(dx) + SQUARE(dy);
+}
+
+static inline double maxd_cells( const Value *oa, unsigned int la,
+                                 const Value *ob, unsigned int lb )
+{
+    int d1, d2, dx, dy;
+    d1 = oa->x + (int)la - 1 - ob->x;
+    d2 = ob->x + (int)lb - 1 - oa->x;
+    dx = (d1 > d2) ? d1 : d2;
+    d1 = oa->y + (int)la - 1 - ob->y;
+    d2 = ob->y + (int)lb - 1 - oa->y;
+    dy = (d1 > d2) ? d1 : d2;
+    return SQUARE(dx) + SQUARE(dy);
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
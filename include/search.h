@@ -3,8 +3,12 @@
 #include "types.h"
 #include "morton.h"
 #include "quadtree.h"
-
-#define SQUARE(x) (x)*(x)
+#include "query.h"
+#include "pairs.h"
+#include "filter.h"
+#include "visit.h"
+#include "gravity.h"
+#include "fmm.h"
 
 typedef struct fargs_s {
     const unsigned int *data;
@@ -15,5 +19,23 @@ typedef struct fargs_s {
 int search_naive( const fargs_t * );
 int search_fast( const fargs_t * );
 int search_fastfast( const fargs_t * );
+int search_neighbours( const fargs_t * );
+int search_fastpath( const fargs_t * );
+int search_fastleaf( const fargs_t * );
+int search_fastsimd( const fargs_t * );
+int search_periodic( const fargs_t * );
+int search_ring( const fargs_t * );
+int search_radius( const fargs_t * );
+int search_count( const fargs_t * );
+int search_visit( const fargs_t * );
+int search_pairs( const fargs_t * );
+int search_dualtree( const fargs_t * );
+int search_pairs_half( const fargs_t * );
+int search_dualtree_half( const fargs_t * );
+int search_pairs_concurrent( const fargs_t * );
+int search_direct( const fargs_t * );
+int search_bh( const fargs_t * );
+int search_direct_log( const fargs_t * );
+int search_fmm( const fargs_t * );
 
 /* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
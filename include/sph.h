@@ -0,0 +1,48 @@
+#pragma once
+
+#include "types.h"
+#include "quadtree.h"
+
+
+/* smoothing kernels, both with support radius 2h */
+typedef enum sph_kernel_e {
+    SPH_CUBIC,          /* cubic B-spline (M4) */
+    SPH_WENDLAND        /* Wendland C2 */
+} sph_kernel_t;
+
+
+/* struct sph_t
+ * particles of a smoothed-particle hydrodynamics step; all per-particle
+ * arrays are in Morton order, i.e. entry k belongs to items[k] (use
+ * items[k].idx to map back to the original order)
+ *
+ * Members
+ * =======
+ * head, Node *            :   root of tree
+ * items, Item *           :   items of the tree, as returned by build_morton
+ * size, size_t            :   number of items
+ * kernel, sph_kernel_t    :   smoothing kernel
+ * mass, double *          :   mass of each particle
+ * h, double *             :   smoothing length of each particle
+ * hmax, double            :   largest smoothing length
+ *
+ */
+typedef struct sph_s {
+    const Node *head;
+    const Item *items;
+    size_t size;
+    sph_kernel_t kernel;
+    const double *mass, *h;
+    double hmax;
+} sph_t;
+
+
+double sph_w( sph_kernel_t, double, double );
+double sph_dw( sph_kernel_t, double, double );
+void sph_init( sph_t *, const Node *, const Item *, size_t, sph_kernel_t,
+               const double *, const double * );
+void sph_density( const sph_t *, unsigned int, double * );
+void sph_accel( const sph_t *, const double *, const double *, unsigned int,
+                double *, double * );
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
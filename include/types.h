@@ -7,7 +7,8 @@
 typedef uint16_t _quadtree_key_t;
 #define key_t _quadtree_key_t
 typedef uint8_t lvl_t;
-static const uint8_t maxlvl = 8;
+#define MAXLVL 8
+static const uint8_t maxlvl = MAXLVL;
 
 typedef struct Value Value;
 typedef struct Item Item;
@@ -38,6 +39,8 @@ struct Node {
     lvl_t lvl;
     Node **c;       /* children */
     uint8_t allocated;
+    Node *p;        /* parent, NULL for the root */
+    size_t n;       /* number of items in subtree, see count_items */
 };
 
 /* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "types.h"
+#include "quadtree.h"
+#include "pairs.h"
+
+
+/* struct verlet_t
+ * Verlet neighbour list: all pairs within r + skin are searched once and
+ * reused over several steps, until some value has moved farther than skin/2
+ * since then (then no pair within r can be missing from the list)
+ *
+ * Members
+ * =======
+ * vals, Value *       :   current values, updated by the caller in place
+ * size, size_t        :   number of values
+ * r_sq, double        :   squared interaction radius
+ * rs_sq, double       :   squared radius of the list, i.e. (r + skin)^2
+ * half_skin_sq, double:   squared displacement, which triggers a rebuild
+ * list, CSR           :   neighbours within r + skin at the last build, rows
+ *                         and indices are indices into vals
+ * ref, Value *        :   values at the last build
+ * items, Item *       :   buffer for build_morton
+ * builds, size_t      :   number of builds so far
+ *
+ */
+typedef struct verlet_s {
+    const Value *vals;
+    size_t size;
+    double r_sq, rs_sq;
+    double half_skin_sq;
+    CSR list;
+    Value *ref;
+    Item *items;
+    size_t builds;
+} verlet_t;
+
+
+void verlet_init( verlet_t *, const Value *, size_t, double, double );
+int verlet_update( verlet_t * );
+void verlet_pairs( const verlet_t *, CSR * );
+void verlet_free( verlet_t * );
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include "types.h"
+#include "query.h"
+
+
+/* visitor_t
+ * called by for_radius for every item within the radius; a nonzero return
+ * value stops the search
+ *
+ */
+typedef int (*visitor_t)( const Item *, void * );
+
+int for_radius( const Value *, double, const Node *, visitor_t, void * );
+
+
+/* RADIUS_VISITOR
+ * define a radius search, which passes every item within r to VISIT instead
+ * of writing it into an array; like find_radius, but in one pass and without
+ * allocations. VISIT is inlined into the traversal, so that filtering or
+ * accumulating the items costs no function call.
+ *
+ * Defines
+ * =======
+ * int NAME( const Value *q, double r_sq, const Node *head, CTX ctx )
+ *     returns 1 if the search was stopped by VISIT, 0 otherwise
+ *
+ * Params
+ * ======
+ * NAME        :   name of the search
+ * CTX         :   type of the context passed to every visit
+ * VISIT       :   expression in `item` (const Item *) and `ctx`; if it
+ *                 evaluates to nonzero, the search is stopped
+ *
+ */
+#define RADIUS_VISITOR(NAME, CTX, VISIT)                                    \
+static int NAME##_all( const Node *head, CTX ctx )                          \
+{                                                                           \
+    uint8_t ci;                                                             \
+    const Item *item;                                                       \
+    if ( (item = head->i) )                                                 \
+        return (VISIT);                                                     \
+    if ( head->c )                                                          \
+        for ( ci = 0; ci < NOC; ++ci )                                      \
+            if ( head->c[ci] && NAME##_all( head->c[ci], ctx ) )            \
+                return 1;                                                   \
+    return 0;                                                               \
+}                                                                           \
+static int NAME##_rec( const Node *head, const Value *q, double r_sq,       \
+                       CTX ctx )                                            \
+{                                                                           \
+    uint8_t ci;                                                             \
+    unsigned int len;                                                       \
+    Value o;                                                                \
+    const Node *n;                                                          \
+    const Item *item;                                                       \
+    if ( (item = head->i) )                                                 \
+        return METRIC(q, item->val) < r_sq && (VISIT);                      \
+    if ( !head->c )     /* vacated by refit */                              \
+        return 0;                                                           \
+    for ( ci = 0; ci < NOC; ++ci ) {                                        \
+        if ( !(n = head->c[ci]) )                                           \
+            continue;                                                       \
+        len = cell(n, &o);                                                  \
+        if ( mind(q, &o, len) >= r_sq )                                     \
+            continue;                                                       \
+        if ( maxd(q, &o, len) < r_sq ? NAME##_all( n, ctx )                 \
+                                     : NAME##_rec( n, q, r_sq, ctx ) )      \
+            return 1;                                                       \
+    }                                                                       \
+    return 0;                                                               \
+}                                                                           \
+static inline int NAME( const Value *q, double r_sq, const Node *head,      \
+                        CTX ctx )                                           \
+{                                                                           \
+    Value o;                                                                \
+    unsigned int len = cell(head, &o);                                      \
+    if ( mind(q, &o, len) >= r_sq )                                         \
+        return 0;                                                           \
+    return NAME##_rec( head, q, r_sq, ctx );                                \
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -11,7 +11,7 @@ import numpy
 
 exclude_1 = ["search.c"]
 exclude_2 = ["cvisualise.c"]
-libs = ["m", "gvc", "cgraph", "cdt"] if not os.name == 'nt' else None
+libs = ["m", "pthread", "gvc", "cgraph", "cdt"] if not os.name == 'nt' else None
 
 ext = Extension(
         "visualise",
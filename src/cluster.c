@@ -0,0 +1,292 @@
+/* This file contains clustering by linking length: friends-of-friends groups
+ * (the connected components of the graph of all pairs closer than b) and
+ * DBSCAN. Pairs are found by radius searches in the tree (see
+ * RADIUS_VISITOR) and merged in a lock-free union-find, so that all items are
+ * processed in parallel. Sets are always linked from the larger to the
+ * smaller root (by Morton index), which makes the result independent of the
+ * order of the unions, i.e. of the number of threads.
+ */
+#include <stdatomic.h>
+#include "cluster.h"
+#include "query.h"
+#include "visit.h"
+#include "parallel.h"
+
+
+/* state of a clustering
+ *
+ * Members
+ * =======
+ * head, Node *            :   root of tree
+ * items, Item *           :   items of the tree, in Morton order
+ * size, size_t            :   number of items
+ * r_sq, double            :   squared linking length
+ * minpts, size_t          :   DBSCAN: minimal number of items within r of a
+ *                             core item (including itself)
+ * parent, atomic_size_t * :   union-find forest over Morton indices
+ * core, uint8_t *         :   DBSCAN: whether item is a core item
+ *
+ */
+typedef struct cl_s {
+    const Node *head;
+    const Item *items;
+    size_t size;
+    double r_sq;
+    size_t minpts;
+    atomic_size_t *parent;
+    uint8_t *core;
+} cl_t;
+
+
+/* find
+ * root of x's set; halves the path on the way (concurrent finds and unions
+ * only ever move an entry closer to its root)
+ *
+ */
+static size_t find( atomic_size_t *parent, size_t x )
+{
+    size_t p, gp;
+
+    while ( (p = atomic_load(&parent[x])) != x ) {
+        gp = atomic_load(&parent[p]);
+        if ( gp != p )
+            atomic_compare_exchange_weak(&parent[x], &p, gp);
+        x = gp;
+    }
+
+    return x;
+}
+
+
+/* unite
+ * merge the sets of a and b by linking the larger root to the smaller one;
+ * retries if the root was linked by another thread in the meantime
+ *
+ */
+static void unite( atomic_size_t *parent, size_t a, size_t b )
+{
+    size_t t;
+
+    for ( ;; ) {
+        a = find( parent, a );
+        b = find( parent, b );
+        if ( a == b )
+            return;
+        if ( a < b ) {
+            t = a; a = b; b = t;
+        }
+        t = a;
+        if ( atomic_compare_exchange_strong(&parent[a], &t, b) )
+            return;
+    }
+}
+
+
+/* visit context: state and Morton index of the query */
+typedef struct vctx_s {
+    cl_t *cl;
+    size_t i;
+    size_t found;       /* DBSCAN border items: first core neighbour */
+} vctx_t;
+
+
+/* fof_link - unite query with item (each pair once); for DBSCAN only cores */
+static inline int fof_link( const Item *item, vctx_t *ctx )
+{
+    size_t j = item - ctx->cl->items;
+
+    if ( j > ctx->i && (!ctx->cl->core || ctx->cl->core[j]) )
+        unite( ctx->cl->parent, ctx->i, j );
+    return 0;
+}
+
+/* first_core - find a core item, stops the search */
+static inline int first_core( const Item *item, vctx_t *ctx )
+{
+    size_t j = item - ctx->cl->items;
+
+    if ( !ctx->cl->core[j] )
+        return 0;
+    ctx->found = j;
+    return 1;
+}
+
+RADIUS_VISITOR(link_all, vctx_t *, fof_link(item, ctx))
+RADIUS_VISITOR(find_core, vctx_t *, first_core(item, ctx))
+
+
+/* link_task - unite items in [b, e) with their neighbours; for DBSCAN, only
+ * core items are linked */
+static void link_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    cl_t *cl    = (cl_t *)ctx;
+    vctx_t vc   = { cl, 0, 0 };
+    (void) tid;
+
+    for ( ; b < e; ++b ) {
+        if ( cl->core && !cl->core[b] )
+            continue;
+        vc.i = b;
+        link_all( cl->items[b].val, cl->r_sq, cl->head, &vc );
+    }
+}
+
+
+/* core_task - mark core items in [b, e) */
+static void core_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    cl_t *cl = (cl_t *)ctx;
+    (void) tid;
+
+    for ( ; b < e; ++b )
+        cl->core[b] = count_radius(cl->items[b].val, cl->r_sq, cl->head)
+            >= cl->minpts;
+}
+
+
+/* border_task - attach non-core items in [b, e) to the set of their first
+ * core neighbour (as found by the search), or mark them as noise; the sets
+ * of the cores are final at this point, so no unions are necessary */
+static void border_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    cl_t *cl    = (cl_t *)ctx;
+    vctx_t vc   = { cl, 0, 0 };
+    (void) tid;
+
+    for ( ; b < e; ++b ) {
+        if ( cl->core[b] )
+            continue;
+        vc.i = b;
+        if ( find_core( cl->items[b].val, cl->r_sq, cl->head, &vc ) )
+            atomic_store(&cl->parent[b], find(cl->parent, vc.found));
+        else
+            atomic_store(&cl->parent[b], CLUSTER_NOISE);
+    }
+}
+
+
+/* cl_init - set up state with every item in a set of its own */
+static void cl_init( cl_t *cl, const Node *head, const Item *items,
+                     size_t size, double r )
+{
+    size_t i;
+
+    cl->head    = head;
+    cl->items   = items;
+    cl->size    = size;
+    cl->r_sq    = r * r;
+    cl->minpts  = 0;
+    cl->core    = NULL;
+    cl->parent  = xmalloc(sizeof(atomic_size_t) * size);
+    for ( i = 0; i < size; ++i )
+        atomic_init(&cl->parent[i], i);
+}
+
+
+/* label
+ * number the sets in the order of their first item in the original order
+ * and write the labels by original index; frees the state
+ *
+ * Returns
+ * =======
+ * number of sets
+ *
+ */
+static size_t label( cl_t *cl, size_t *labels )
+{
+    size_t i, r, num = 0;
+    size_t *rank = xmalloc(sizeof(size_t) * cl->size);    /* by Morton index */
+    size_t *root = xmalloc(sizeof(size_t) * cl->size);    /* by original */
+
+    for ( i = 0; i < cl->size; ++i ) {
+        r = atomic_load(&cl->parent[i]);
+        root[cl->items[i].idx] = r == CLUSTER_NOISE ? r : find(cl->parent, i);
+        rank[i] = CLUSTER_NOISE;
+    }
+    for ( i = 0; i < cl->size; ++i ) {
+        if ( (r = root[i]) == CLUSTER_NOISE ) {
+            labels[i] = CLUSTER_NOISE;
+            continue;
+        }
+        if ( rank[r] == CLUSTER_NOISE )
+            rank[r] = num++;
+        labels[i] = rank[r];
+    }
+
+    free(rank);
+    free(root);
+    free(cl->parent);
+    free(cl->core);
+
+    return num;
+}
+
+
+/* cluster_fof
+ * friends-of-friends groups: two items are in the same group, if they are
+ * connected by a chain of items, each closer than b to the next one
+ *
+ * Params
+ * ======
+ * head, Node *            :   root of tree built from items
+ * items, Item *           :   items, as returned by build_morton
+ * size, size_t            :   number of items
+ * b, double               :   linking length
+ * nthreads, unsigned int  :   number of threads (0: one per processor)
+ * labels, size_t *        :   array of size `size`; group of each item by
+ *                             original index (Item.idx); groups are numbered
+ *                             from 0 in the order of their first item
+ *
+ * Returns
+ * =======
+ * number of groups (including single items)
+ *
+ */
+size_t cluster_fof( const Node *head, const Item *items, size_t size,
+                    double b, unsigned int nthreads, size_t *labels )
+{
+    cl_t cl;
+
+    cl_init( &cl, head, items, size, b );
+    parallel_for( size, 0, nthreads, link_task, &cl );
+
+    return label( &cl, labels );
+}
+
+
+/* cluster_dbscan
+ * DBSCAN: items with at least minpts items (including themselves) closer than
+ * eps are core items; clusters are the friends-of-friends groups of the core
+ * items, every other item closer than eps to a core item joins the cluster of
+ * one of them (border item), the remaining items are noise
+ *
+ * Params
+ * ======
+ * head, items, size, nthreads :   see cluster_fof
+ * eps, double                 :   radius
+ * minpts, size_t              :   minimal number of items of a core item's
+ *                                 neighbourhood
+ * labels, size_t *            :   see cluster_fof; CLUSTER_NOISE for noise
+ *
+ * Returns
+ * =======
+ * number of clusters
+ *
+ */
+size_t cluster_dbscan( const Node *head, const Item *items, size_t size,
+                       double eps, size_t minpts, unsigned int nthreads,
+                       size_t *labels )
+{
+    cl_t cl;
+
+    cl_init( &cl, head, items, size, eps );
+    cl.minpts   = minpts;
+    cl.core     = xmalloc(size);
+    parallel_for( size, 0, nthreads, core_task, &cl );
+    parallel_for( size, 0, nthreads, link_task, &cl );
+    parallel_for( size, 0, nthreads, border_task, &cl );
+
+    return label( &cl, labels );
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
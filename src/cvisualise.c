@@ -163,6 +163,8 @@ QuadtreeEnv *qtenv_setup(const unsigned int *in, size_t size, unsigned int *si)
     head->key = 0;
     head->lvl = 0;
     head->i = NULL;
+    head->p = NULL;
+    head->n = 0;
     head->c = xmalloc(sizeof(Node *)*NOC);
     for ( i = 0; i < NOC; ++i ) head->c[i] = NULL;
     this = xmalloc(sizeof(QuadtreeEnv));
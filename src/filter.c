@@ -0,0 +1,171 @@
+/* This file contains the distance filter applied to the candidates returned
+ * by find_neighbours. Since values are 8 bit, the squared distances are exact
+ * 32 bit integers: the differences are computed on 16 bit lanes, and
+ * multiplied and summed pairwise by a single madd. AVX2 (16 candidates per
+ * step) or SSE2 (8 candidates) is used if enabled at compile time (e.g. with
+ * -mavx2 or -march=native), otherwise a scalar loop.
+ */
+#include <math.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "filter.h"
+
+
+/* largest possible squared distance of two values */
+#define MAX_SD (2 * 255 * 255)
+
+
+/* filter_init
+ * initialise empty workspace
+ *
+ */
+void filter_init( filter_ws_t *ws )
+{
+    ws->x       = NULL;
+    ws->y       = NULL;
+    ws->size    = 0;
+}
+
+
+/* filter_free
+ * free buffers of workspace
+ *
+ */
+void filter_free( filter_ws_t *ws )
+{
+    free(ws->x);
+    free(ws->y);
+    filter_init( ws );
+}
+
+
+/* gather
+ * copy values of the candidates into the workspace
+ *
+ */
+static void gather( const DArray_Item *cand, filter_ws_t *ws )
+{
+    size_t i;
+
+    if ( ws->size < cand->_used ) {
+        free(ws->x);
+        free(ws->y);
+        ws->size    = cand->_used;
+        ws->x       = xmalloc(sizeof(int16_t) * ws->size);
+        ws->y       = xmalloc(sizeof(int16_t) * ws->size);
+    }
+    for ( i = 0; i < cand->_used; ++i ) {
+        ws->x[i] = cand->p[i]->val->x;
+        ws->y[i] = cand->p[i]->val->y;
+    }
+}
+
+
+#if defined(__AVX2__) || defined(__SSE2__)
+/* compact
+ * append candidates at offset + k to res, for every lane k set in mask (as
+ * returned by movemask_epi8 of 16 bit lanes, i.e. two bits per lane)
+ *
+ */
+static inline size_t compact( unsigned int mask, const DArray_Item *cand,
+                              size_t offset, DArray_Item *res )
+{
+    size_t num = 0;
+    unsigned int k;
+
+    while ( mask ) {
+        k = __builtin_ctz(mask);
+        DArray_Item_append(res, cand->p[offset + k/2]);
+        mask &= ~(3u << k);
+        ++num;
+    }
+    return num;
+}
+#endif
+
+
+/* filter_radius
+ * append all candidates with a distance less than r to the query to res, in
+ * the order of cand; same result as testing each with METRIC
+ *
+ * Params
+ * ======
+ * q, Value *          :   query
+ * cand, DArray_Item * :   candidates, e.g. from find_neighbours
+ * r_sq, double        :   squared radius
+ * ws, filter_ws_t *   :   workspace, see filter_init
+ * res, DArray_Item *  :   result, is appended to
+ *
+ * Returns
+ * =======
+ * number of appended items
+ *
+ */
+size_t filter_radius( const Value *q, const DArray_Item *cand, double r_sq,
+                      filter_ws_t *ws, DArray_Item *res )
+{
+    size_t i = 0, num = 0, n = cand->_used;
+    int32_t thr, d;
+
+    /* integer d < r_sq  <=>  d < ceil(r_sq) */
+    if ( r_sq <= 0 )
+        return 0;
+    thr = (r_sq > MAX_SD) ? MAX_SD + 1 : (int32_t)ceil(r_sq);
+
+    gather( cand, ws );
+
+#if defined(__AVX2__)
+    {
+        __m256i qx = _mm256_set1_epi16(q->x), qy = _mm256_set1_epi16(q->y);
+        __m256i t = _mm256_set1_epi32(thr), dx, dy, lo, hi;
+
+        for ( ; i + 16 <= n; i += 16 ) {
+            dx = _mm256_sub_epi16(
+                    _mm256_loadu_si256((const __m256i *)(ws->x + i)), qx);
+            dy = _mm256_sub_epi16(
+                    _mm256_loadu_si256((const __m256i *)(ws->y + i)), qy);
+            /* (dx, dy) pairs of lanes 0-3, 8-11 and 4-7, 12-15 */
+            lo = _mm256_unpacklo_epi16(dx, dy);
+            hi = _mm256_unpackhi_epi16(dx, dy);
+            lo = _mm256_cmpgt_epi32(t, _mm256_madd_epi16(lo, lo));
+            hi = _mm256_cmpgt_epi32(t, _mm256_madd_epi16(hi, hi));
+            /* packing works on 128 bit halves too, so it restores order */
+            num += compact( (unsigned int)_mm256_movemask_epi8(
+                        _mm256_packs_epi32(lo, hi)), cand, i, res );
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        __m128i qx = _mm_set1_epi16(q->x), qy = _mm_set1_epi16(q->y);
+        __m128i t = _mm_set1_epi32(thr), dx, dy, lo, hi;
+
+        for ( ; i + 8 <= n; i += 8 ) {
+            dx = _mm_sub_epi16(
+                    _mm_loadu_si128((const __m128i *)(ws->x + i)), qx);
+            dy = _mm_sub_epi16(
+                    _mm_loadu_si128((const __m128i *)(ws->y + i)), qy);
+            lo = _mm_unpacklo_epi16(dx, dy);
+            hi = _mm_unpackhi_epi16(dx, dy);
+            lo = _mm_cmplt_epi32(_mm_madd_epi16(lo, lo), t);
+            hi = _mm_cmplt_epi32(_mm_madd_epi16(hi, hi), t);
+            num += compact( (unsigned int)_mm_movemask_epi8(
+                        _mm_packs_epi32(lo, hi)), cand, i, res );
+        }
+    }
+#endif
+
+    /* remainder */
+    for ( ; i < n; ++i ) {
+        d = SQUARE(ws->x[i] - q->x) + SQUARE(ws->y[i] - q->y);
+        if ( d < thr ) {
+            DArray_Item_append(res, cand->p[i]);
+            ++num;
+        }
+    }
+
+    return num;
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -0,0 +1,493 @@
+/* This file contains a fast multipole method for the 2D gravity of point
+ * masses, i.e. the logarithmic potential
+ *     phi(z) = sum_j m_j log(z - z_j),    a(z) = -conj(phi'(z)),
+ * with the expansions and translations of Greengard and Rokhlin (1987) on the
+ * nodes of the tree, which adapts to clustered items:
+ *
+ *  - upward pass: multipole expansions of the leaves are formed from their
+ *    items (P2M) and shifted to the parents (M2M)
+ *  - interactions: pairs of nodes are traversed, starting at (target, root);
+ *    if they are well separated, i.e. r_a + r_b < THETA * |z_a - z_b|, the
+ *    multipole expansion of the source is added to the local expansion of
+ *    the target (M2L); otherwise the larger one is split, pairs of leaves are
+ *    summed directly (P2P)
+ *  - downward pass: local expansions are shifted to the children (L2L) and
+ *    evaluated at the items of the leaves (L2P)
+ *
+ * The subtrees of the frontier (see fcell_t) are processed in parallel: the
+ * interactions of a target only write into its own subtree.
+ */
+#include <math.h>
+#include <string.h>
+#include "fmm.h"
+#include "morton.h"
+#include "parallel.h"
+
+
+/* well-separatedness of two cells, the error decreases like THETA^order */
+#define THETA 0.5
+/* nodes with at most that many items are leaves, if not specified */
+#define LEAF 16
+
+#define BINOM(f, n, k) (f)->binom[(n) * (2 * (f)->order + 1) + (k)]
+#define ME(f, k) ((f)->me + (k) * ((f)->order + 1))
+#define LE(f, k) ((f)->le + (k) * ((f)->order + 1))
+#define MASS(f, i) ((f)->mass ? (f)->mass[(i)->idx] : 1)
+
+
+/* pos - position of an item */
+static inline double complex pos( const Item *i )
+{
+    return i->val->x + i->val->y * I;
+}
+
+
+/* is_leaf - whether the cell has no children */
+static inline int is_leaf( const fcell_t *c )
+{
+    uint8_t i;
+
+    for ( i = 0; i < NOC; ++i )
+        if ( c->c[i] )
+            return 0;
+    return 1;
+}
+
+
+/* count_cells - number of cells of n's subtree */
+static size_t count_cells( const fmm_t *f, const Node *n )
+{
+    uint8_t i;
+    size_t num = 1;
+
+    if ( n->n <= f->leaf || !n->c )
+        return num;
+    for ( i = 0; i < NOC; ++i )
+        if ( n->c[i] && n->c[i]->n )
+            num += count_cells( f, n->c[i] );
+    return num;
+}
+
+
+/* collect - append items of n's subtree to f->it */
+static void collect( fmm_t *f, const Node *n, size_t *num )
+{
+    uint8_t i;
+
+    if ( n->i )
+        f->it[(*num)++] = n->i;
+    else if ( n->c )
+        for ( i = 0; i < NOC; ++i )
+            if ( n->c[i] )
+                collect( f, n->c[i], num );
+}
+
+
+/* gather
+ * append cell of node n (and of its subtree) to f->cells
+ *
+ * Returns
+ * =======
+ * index of n's cell
+ *
+ */
+static size_t gather( fmm_t *f, const Node *n, size_t *num )
+{
+    uint8_t i;
+    size_t k = f->ncells++, j, c;
+    fcell_t *fc = &f->cells[k];
+    Value o = coords2(n->key << DIM * (maxlvl - n->lvl));
+    double h = ((256u >> n->lvl) - 1) / 2.0, d;
+
+    fc->z       = (o.x + h) + (o.y + h) * I;
+    fc->b       = *num;
+    fc->front   = 0;
+    for ( i = 0; i < NOC; ++i )
+        fc->c[i] = 0;
+
+    if ( n->n <= f->leaf || !n->c ) {
+        collect( f, n, num );
+    } else {
+        for ( i = 0; i < NOC; ++i ) {
+            if ( !n->c[i] || !n->c[i]->n )
+                continue;
+            c = gather( f, n->c[i], num );
+            fc->c[i] = c;
+        }
+    }
+    fc->e = *num;
+
+    for ( j = fc->b, fc->r = 0; j < fc->e; ++j )
+        if ( (d = cabs(pos(f->it[j]) - fc->z)) > fc->r )
+            fc->r = d;
+
+    return k;
+}
+
+
+/* frontier
+ * mark and list the topmost cells of k's subtree with at most thr items
+ *
+ */
+static void frontier( fmm_t *f, size_t k, size_t thr )
+{
+    uint8_t i;
+    fcell_t *fc = &f->cells[k];
+
+    if ( fc->e - fc->b <= thr || is_leaf(fc) ) {
+        fc->front = 1;
+        f->front[f->nfront++] = k;
+        return;
+    }
+    for ( i = 0; i < NOC; ++i )
+        if ( fc->c[i] )
+            frontier( f, fc->c[i], thr );
+}
+
+
+/* fmm_init
+ * set up the cells of a tree and allocate expansions
+ *
+ * Params
+ * ======
+ * f, fmm_t *              :   to initialise, free with fmm_free
+ * head, Node *            :   root of tree, with up to date item counts (see
+ *                             count_items)
+ * mass, double *          :   masses by original index (Item.idx),
+ *                             referenced; NULL for unit masses
+ * order, unsigned int     :   number of terms of the expansions (>= 1); the
+ *                             error decreases roughly like 0.5^order
+ * leaf, size_t            :   nodes with at most that many items are leaves
+ *                             (0: 16)
+ *
+ */
+void fmm_init( fmm_t *f, const Node *head, const double *mass,
+               unsigned int order, size_t leaf )
+{
+    size_t i, j, n, num = 0;
+
+    f->head     = head;
+    f->mass     = mass;
+    f->size     = head->n;
+    f->order    = order;
+    f->leaf     = leaf ? leaf : LEAF;
+    n           = count_cells( f, head );
+
+    f->cells    = xmalloc(sizeof(fcell_t) * n);
+    f->it       = xmalloc(sizeof(const Item *) * (f->size + 1));
+    f->front    = xmalloc(sizeof(size_t) * n);
+    f->me       = xmalloc(sizeof(double complex) * n * (order + 1));
+    f->le       = xmalloc(sizeof(double complex) * n * (order + 1));
+    f->ncells   = 0;
+    f->nfront   = 0;
+    gather( f, head, &num );
+    frontier( f, 0, f->size / 64 > f->leaf ? f->size / 64 : f->leaf );
+
+    n = 2 * order + 1;
+    f->binom = xmalloc(sizeof(double) * n * n);
+    for ( i = 0; i < n; ++i )
+        for ( j = 0; j < n; ++j )
+            BINOM(f, i, j) = (j == 0 || j == i) ? 1
+                : (j > i ? 0 : BINOM(f, i-1, j-1) + BINOM(f, i-1, j));
+}
+
+
+/* p2m - multipole expansion a of the items of cell fc */
+static void p2m( const fmm_t *f, const fcell_t *fc, double complex *a )
+{
+    unsigned int k, p = f->order;
+    size_t j;
+    double complex d, dk;
+    double m;
+
+    for ( k = 0; k <= p; ++k )
+        a[k] = 0;
+    for ( j = fc->b; j < fc->e; ++j ) {
+        m       = MASS(f, f->it[j]);
+        d       = pos(f->it[j]) - fc->z;
+        a[0]   += m;
+        for ( k = 1, dk = d; k <= p; ++k, dk *= d )
+            a[k] -= m * dk / k;
+    }
+}
+
+
+/* m2m - add multipole expansion c around zc to a around za */
+static void m2m( const fmm_t *f, const double complex *c, double complex zc,
+                 double complex *a, double complex za )
+{
+    unsigned int k, l, p = f->order;
+    double complex z0 = zc - za, zp[p + 1];
+
+    for ( k = 0, zp[0] = 1; k < p; ++k )
+        zp[k+1] = zp[k] * z0;
+
+    a[0] += c[0];
+    for ( l = 1; l <= p; ++l ) {
+        a[l] -= c[0] * zp[l] / l;
+        for ( k = 1; k <= l; ++k )
+            a[l] += c[k] * zp[l-k] * BINOM(f, l-1, k-1);
+    }
+}
+
+
+/* m2l - add multipole expansion a around zs to local expansion c around zt;
+ * c_0 (the potential) isn't needed for accelerations */
+static void m2l( const fmm_t *f, const double complex *a, double complex zs,
+                 double complex *c, double complex zt )
+{
+    unsigned int k, l, p = f->order;
+    double complex z0 = zs - zt, inv = 1 / z0, ip[p + 1], t[p + 1], sum;
+
+    for ( k = 0, ip[0] = 1; k < p; ++k )
+        ip[k+1] = ip[k] * inv;
+    /* t_k = (-1)^k a_k / z0^k */
+    for ( k = 1; k <= p; ++k )
+        t[k] = (k & 1 ? -a[k] : a[k]) * ip[k];
+
+    for ( l = 1; l <= p; ++l ) {
+        sum = -a[0] / l;
+        for ( k = 1; k <= p; ++k )
+            sum += t[k] * BINOM(f, l+k-1, k-1);
+        c[l] += sum * ip[l];
+    }
+}
+
+
+/* l2l - add local expansion c around zc to local expansion d around zd */
+static void l2l( const fmm_t *f, const double complex *c, double complex zc,
+                 double complex *d, double complex zd )
+{
+    unsigned int k, l, p = f->order;
+    double complex z0 = zd - zc, zp[p + 1];
+
+    for ( k = 0, zp[0] = 1; k < p; ++k )
+        zp[k+1] = zp[k] * z0;
+    /* d_l = sum_{k >= l} c_k C(k, l) z0^(k-l) */
+    for ( l = 1; l <= p; ++l )
+        for ( k = l; k <= p; ++k )
+            d[l] += c[k] * BINOM(f, k, l) * zp[k-l];
+}
+
+
+/* up - multipole expansions of k's subtree; if top is set, stop at (and
+ * don't recompute) the frontier */
+static void up( fmm_t *f, size_t k, int top )
+{
+    uint8_t i;
+    unsigned int j;
+    const fcell_t *fc = &f->cells[k];
+
+    if ( top && fc->front )
+        return;
+    if ( is_leaf(fc) ) {
+        p2m( f, fc, ME(f, k) );
+        return;
+    }
+    for ( j = 0; j <= f->order; ++j )
+        ME(f, k)[j] = 0;
+    for ( i = 0; i < NOC; ++i ) {
+        if ( !fc->c[i] )
+            continue;
+        up( f, fc->c[i], top );
+        m2m( f, ME(f, fc->c[i]), f->cells[fc->c[i]].z, ME(f, k), fc->z );
+    }
+}
+
+
+/* state of the interactions of one frontier cell */
+typedef struct iargs_s {
+    fmm_t *f;
+    double complex *acc;    /* derivative of potential, by position in it */
+    double *ax, *ay;
+} iargs_t;
+
+
+/* p2p - add the field of the items of b at the items of a */
+static void p2p( iargs_t *ia, const fcell_t *a, const fcell_t *b )
+{
+    fmm_t *f = ia->f;
+    size_t i, j;
+    double complex z;
+
+    for ( i = a->b; i < a->e; ++i ) {
+        z = pos(f->it[i]);
+        for ( j = b->b; j < b->e; ++j )
+            if ( j != i )
+                ia->acc[i] += MASS(f, f->it[j]) / (z - pos(f->it[j]));
+    }
+}
+
+
+/* inter - interactions of target cell a with source cell b */
+static void inter( iargs_t *ia, size_t a, size_t b )
+{
+    uint8_t i;
+    fmm_t *f            = ia->f;
+    const fcell_t *ca   = &f->cells[a], *cb = &f->cells[b];
+    int la, lb;
+
+    if ( ca->r + cb->r < THETA * cabs(ca->z - cb->z) ) {
+        m2l( f, ME(f, b), cb->z, LE(f, a), ca->z );
+        return;
+    }
+
+    la = is_leaf(ca);
+    lb = is_leaf(cb);
+    if ( la && lb ) {
+        p2p( ia, ca, cb );
+    } else if ( lb || (!la && ca->r >= cb->r) ) {
+        for ( i = 0; i < NOC; ++i )
+            if ( ca->c[i] )
+                inter( ia, ca->c[i], b );
+    } else {
+        for ( i = 0; i < NOC; ++i )
+            if ( cb->c[i] )
+                inter( ia, a, cb->c[i] );
+    }
+}
+
+
+/* down - shift local expansions of k's subtree down and evaluate them */
+static void down( iargs_t *ia, size_t k )
+{
+    uint8_t i;
+    unsigned int l;
+    size_t j;
+    fmm_t *f            = ia->f;
+    const fcell_t *fc   = &f->cells[k];
+    const double complex *c = LE(f, k);
+    double complex d, acc;
+
+    if ( !is_leaf(fc) ) {
+        for ( i = 0; i < NOC; ++i ) {
+            if ( !fc->c[i] )
+                continue;
+            l2l( f, c, fc->z, LE(f, fc->c[i]), f->cells[fc->c[i]].z );
+            down( ia, fc->c[i] );
+        }
+        return;
+    }
+
+    for ( j = fc->b; j < fc->e; ++j ) {
+        d   = pos(f->it[j]) - fc->z;
+        acc = 0;
+        for ( l = f->order; l >= 1; --l )
+            acc = acc * d + l * c[l];
+        acc += ia->acc[j];
+        ia->ax[f->it[j]->idx] = -creal(acc);
+        ia->ay[f->it[j]->idx] = cimag(acc);
+    }
+}
+
+
+/* up_task - multipole expansions of frontier cells in [b, e) */
+static void up_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    iargs_t *ia = (iargs_t *)ctx;
+    (void) tid;
+
+    for ( ; b < e; ++b )
+        up( ia->f, ia->f->front[b], 0 );
+}
+
+
+/* down_task - interactions and downward pass of frontier cells in [b, e) */
+static void down_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    iargs_t *ia = (iargs_t *)ctx;
+    (void) tid;
+
+    for ( ; b < e; ++b ) {
+        inter( ia, ia->f->front[b], 0 );
+        down( ia, ia->f->front[b] );
+    }
+}
+
+
+/* fmm_accel
+ * compute the accelerations of all items by the upward pass, the
+ * interactions and the downward pass; call again after the masses changed
+ *
+ * Params
+ * ======
+ * f, fmm_t *              :   initialised by fmm_init
+ * nthreads, unsigned int  :   number of threads (0: one per processor)
+ * ax, ay, double *        :   arrays of size f->size; acceleration by
+ *                             original index (Item.idx)
+ *
+ */
+void fmm_accel( fmm_t *f, unsigned int nthreads, double *ax, double *ay )
+{
+    size_t i;
+    iargs_t ia = { f, NULL, ax, ay };
+
+    ia.acc = xmalloc(sizeof(double complex) * (f->size + 1));
+    for ( i = 0; i < f->size; ++i )
+        ia.acc[i] = 0;
+    for ( i = 0; i < f->ncells * (f->order + 1); ++i )
+        f->le[i] = 0;
+
+    parallel_for( f->nfront, 0, nthreads, up_task, &ia );
+    up( f, 0, 1 );
+    parallel_for( f->nfront, 0, nthreads, down_task, &ia );
+
+    free(ia.acc);
+}
+
+
+/* fmm_free
+ * free buffers of f
+ *
+ */
+void fmm_free( fmm_t *f )
+{
+    free(f->cells);
+    free(f->it);
+    free(f->front);
+    free(f->me);
+    free(f->le);
+    free(f->binom);
+    f->cells    = NULL;
+    f->it       = NULL;
+    f->front    = NULL;
+    f->me = f->le = NULL;
+    f->binom    = NULL;
+}
+
+
+/* direct_accel_log
+ * exact accelerations of the logarithmic potential by direct summation over
+ * all pairs, in O(n^2); as reference for fmm_accel
+ *
+ * Params
+ * ======
+ * vals, Value *       :   values
+ * mass, double *      :   masses (NULL for unit masses)
+ * size, size_t        :   number of values
+ * ax, ay, double *    :   arrays of size `size`; acceleration of each value
+ *
+ */
+void direct_accel_log( const Value *vals, const double *mass, size_t size,
+                       double *ax, double *ay )
+{
+    size_t i, j;
+    double dx, dy, d_sq;
+
+    for ( i = 0; i < size; ++i )
+        ax[i] = ay[i] = 0;
+
+    for ( i = 0; i < size; ++i ) {
+        for ( j = i + 1; j < size; ++j ) {
+            dx      = (double)vals[j].x - vals[i].x;
+            dy      = (double)vals[j].y - vals[i].y;
+            d_sq    = dx*dx + dy*dy;
+            ax[i]  += (mass ? mass[j] : 1) * dx / d_sq;
+            ay[i]  += (mass ? mass[j] : 1) * dy / d_sq;
+            ax[j]  -= (mass ? mass[i] : 1) * dx / d_sq;
+            ay[j]  -= (mass ? mass[i] : 1) * dy / d_sq;
+        }
+    }
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -0,0 +1,251 @@
+/* This file contains a Barnes-Hut solver for softened gravity,
+ *     a_i = sum_j m_j (x_j - x_i) / (|x_j - x_i|^2 + eps^2)^(3/2),
+ * on the values of a tree: mass and centre of mass of every node are
+ * computed in one bottom-up pass, then for every item the tree is descended
+ * and cells which appear small enough from the item are replaced by their
+ * centre of mass. The items are processed in parallel in Morton order, so
+ * that consecutive items of a thread descend similar paths.
+ */
+#include <math.h>
+#include "gravity.h"
+#include "morton.h"
+#include "parallel.h"
+
+
+/* count_nodes - number of nodes of head's subtree */
+static size_t count_nodes( const Node *head )
+{
+    uint8_t i;
+    size_t num = 1;
+
+    if ( head->c )
+        for ( i = 0; i < NOC; ++i )
+            if ( head->c[i] )
+                num += count_nodes( head->c[i] );
+    return num;
+}
+
+
+/* moments
+ * append cell of head (and of its subtree) to bh->cells and compute mass and
+ * centre of mass of head's subtree
+ *
+ * Returns
+ * =======
+ * index of head's cell
+ *
+ */
+static size_t moments( bh_t *bh, const Node *head )
+{
+    uint8_t i;
+    size_t k = bh->ncells++, c;
+    bcell_t *bc = &bh->cells[k];
+    double m = 0, mx = 0, my = 0;
+
+    bc->node = head;
+    for ( i = 0; i < NOC; ++i )
+        bc->c[i] = 0;
+
+    if ( head->i ) {
+        m   = bh->mass ? bh->mass[head->i->idx] : 1;
+        mx  = m * head->i->val->x;
+        my  = m * head->i->val->y;
+    } else if ( head->c ) {
+        for ( i = 0; i < NOC; ++i ) {
+            if ( !head->c[i] )
+                continue;
+            c   = moments( bh, head->c[i] );
+            bc->c[i] = c;
+            m  += bh->cells[c].m;
+            mx += bh->cells[c].m * bh->cells[c].cx;
+            my += bh->cells[c].m * bh->cells[c].cy;
+        }
+    }
+
+    bc->m   = m;
+    bc->cx  = m > 0 ? mx / m : 0;
+    bc->cy  = m > 0 ? my / m : 0;
+
+    return k;
+}
+
+
+/* bh_init
+ * allocate moments for the nodes of given tree and compute them
+ *
+ * Params
+ * ======
+ * bh, bh_t *      :   moments to initialise, free with bh_free
+ * head, Node *    :   root of tree
+ * mass, double *  :   masses by original index (Item.idx), referenced (not
+ *                     copied); NULL for unit masses
+ *
+ */
+void bh_init( bh_t *bh, const Node *head, const double *mass )
+{
+    bh->head    = head;
+    bh->mass    = mass;
+    bh->cells   = NULL;
+    bh_update( bh );
+}
+
+
+/* bh_update
+ * recompute moments, e.g. after the values or masses changed and the tree was
+ * refit (which may add or remove nodes)
+ *
+ */
+void bh_update( bh_t *bh )
+{
+    free(bh->cells);
+    bh->cells   = xmalloc(sizeof(bcell_t) * count_nodes( bh->head ));
+    bh->ncells  = 0;
+    moments( bh, bh->head );
+}
+
+
+/* arguments of bh_accel's task */
+typedef struct gargs_s {
+    const bh_t *bh;
+    const Item *items;
+    double theta_sq, eps_sq;
+    double *ax, *ay;
+} gargs_t;
+
+
+/* walk
+ * add acceleration of item q by head's subtree to a: a cell is accepted, if
+ * it doesn't contain q and len < theta * d (d: distance from q to its centre
+ * of mass), otherwise its children are visited
+ *
+ */
+static void walk( const gargs_t *ga, size_t k, const Item *q, double *a )
+{
+    uint8_t i;
+    unsigned int len;
+    const bcell_t *bc   = &ga->bh->cells[k];
+    const Node *head    = bc->node;
+    double dx, dy, d_sq, f;
+    Value o;
+
+    if ( bc->m <= 0 || head->i == q )
+        return;
+
+    dx      = bc->cx - q->val->x;
+    dy      = bc->cy - q->val->y;
+    d_sq    = dx*dx + dy*dy;
+
+    if ( !head->i ) {
+        len = 256u >> head->lvl;
+        o   = coords2(head->key << DIM * (maxlvl - head->lvl));
+        /* open cell */
+        if ( (q->val->x >= o.x && (unsigned int)(q->val->x - o.x) < len
+                    && q->val->y >= o.y
+                    && (unsigned int)(q->val->y - o.y) < len)
+                || (double)len * len >= ga->theta_sq * d_sq ) {
+            for ( i = 0; i < NOC; ++i )
+                if ( bc->c[i] )
+                    walk( ga, bc->c[i], q, a );
+            return;
+        }
+    }
+
+    d_sq   += ga->eps_sq;
+    f       = bc->m / (d_sq * sqrt(d_sq));
+    a[0]   += f * dx;
+    a[1]   += f * dy;
+}
+
+
+/* accel_task - accelerations of items in [b, e) */
+static void accel_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    gargs_t *ga = (gargs_t *)ctx;
+    double a[2];
+    (void) tid;
+
+    for ( ; b < e; ++b ) {
+        a[0] = a[1] = 0;
+        walk( ga, 0, &ga->items[b], a );
+        ga->ax[ga->items[b].idx] = a[0];
+        ga->ay[ga->items[b].idx] = a[1];
+    }
+}
+
+
+/* bh_accel
+ * approximate the acceleration of every item by the others
+ *
+ * Params
+ * ======
+ * bh, bh_t *              :   moments of the tree
+ * items, Item *           :   items of the tree, as returned by build_morton
+ * size, size_t            :   number of items
+ * theta, double           :   opening angle; 0 gives the exact sum, larger
+ *                             values are faster and less accurate (0.5 is a
+ *                             common choice)
+ * eps_sq, double          :   squared softening length (> 0 avoids the
+ *                             singularity of close pairs)
+ * nthreads, unsigned int  :   number of threads (0: one per processor)
+ * ax, ay, double *        :   arrays of size `size`; acceleration by
+ *                             original index (Item.idx)
+ *
+ */
+void bh_accel( const bh_t *bh, const Item *items, size_t size, double theta,
+               double eps_sq, unsigned int nthreads, double *ax, double *ay )
+{
+    gargs_t ga = { bh, items, theta * theta, eps_sq, ax, ay };
+
+    parallel_for( size, 0, nthreads, accel_task, &ga );
+}
+
+
+/* bh_free
+ * free moments
+ *
+ */
+void bh_free( bh_t *bh )
+{
+    free(bh->cells);
+    bh->cells   = NULL;
+    bh->ncells  = 0;
+}
+
+
+/* direct_accel
+ * exact accelerations by direct summation over all pairs, in O(n^2); as
+ * reference for bh_accel
+ *
+ * Params
+ * ======
+ * vals, Value *       :   values
+ * mass, double *      :   masses (NULL for unit masses)
+ * size, size_t        :   number of values
+ * eps_sq, double      :   squared softening length
+ * ax, ay, double *    :   arrays of size `size`; acceleration of each value
+ *
+ */
+void direct_accel( const Value *vals, const double *mass, size_t size,
+                   double eps_sq, double *ax, double *ay )
+{
+    size_t i, j;
+    double dx, dy, d_sq, f;
+
+    for ( i = 0; i < size; ++i )
+        ax[i] = ay[i] = 0;
+
+    for ( i = 0; i < size; ++i ) {
+        for ( j = i + 1; j < size; ++j ) {
+            dx      = (double)vals[j].x - vals[i].x;
+            dy      = (double)vals[j].y - vals[i].y;
+            d_sq    = dx*dx + dy*dy + eps_sq;
+            f       = 1 / (d_sq * sqrt(d_sq));
+            ax[i]  += (mass ? mass[j] : 1) * f * dx;
+            ay[i]  += (mass ? mass[j] : 1) * f * dy;
+            ax[j]  -= (mass ? mass[i] : 1) * f * dx;
+            ay[j]  -= (mass ? mass[i] : 1) * f * dy;
+        }
+    }
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -0,0 +1,438 @@
+/* This file contains all-pairs neighbour searches, i.e. for every item of a
+ * tree the list of all other items within a given radius. The result is
+ * written into a CSR struct, whose buffers are sized in a counting pass, so
+ * that no reallocation is necessary while collecting neighbours.
+ */
+#include "pairs.h"
+#include "parallel.h"
+
+
+/* query of pairs_radius
+ *
+ * Members
+ * =======
+ * q, Item *       :   query item, is not part of its own result
+ * r_sq, double    :   squared radius
+ * half, int       :   if set, ignore items before q in Morton order
+ *
+ */
+typedef struct query_s {
+    const Item *q;
+    double r_sq;
+    int half;
+} query_t;
+
+
+/* last_key
+ * largest key (on level maxlvl) inside of given node's cell
+ *
+ */
+static inline unsigned int last_key( const Node *n )
+{
+    return ((n->key + 1u) << DIM * (maxlvl - n->lvl)) - 1;
+}
+
+
+/* take
+ * whether the item of a leaf is part of the query's result
+ *
+ */
+static inline int take( const Item *i, const query_t *qu )
+{
+    return i != qu->q && (!qu->half || i->key > qu->q->key)
+        && METRIC(qu->q->val, i->val) < qu->r_sq;
+}
+
+
+/* visit
+ * whether the subtree of a child with given cell has to be searched
+ *
+ */
+static inline int visit( const Node *n, const Value *o, unsigned int len,
+                         const query_t *qu )
+{
+    return mind(qu->q->val, o, len) < qu->r_sq
+        && (!qu->half || last_key(n) > qu->q->key);
+}
+
+
+/* inside - whether v lies in the cell with origin o and edge length len */
+static inline int inside( const Value *v, const Value *o, unsigned int len )
+{
+    return v->x >= o->x && (unsigned int)(v->x - o->x) < len
+        && v->y >= o->y && (unsigned int)(v->y - o->y) < len;
+}
+
+
+/* cnt - count items of query's result in head's subtree, whose cell has
+ * origin o and edge length len; without half, a child whose cell lies
+ * completely inside the radius contributes its item count (less the query
+ * itself, if it is inside of the cell)
+ *
+ */
+static size_t cnt( const Node *head, const Value *o, unsigned int len,
+                   const query_t *qu )
+{
+    uint8_t i;
+    size_t num = 0;
+    unsigned int lc;
+    Value oc;
+
+    if ( head->i )
+        return take(head->i, qu);
+    if ( !head->c )
+        return 0;
+
+    for ( i = 0; i < NOC; ++i ) {
+        if ( !head->c[i] )
+            continue;
+        lc = child_cell(o, len, i, &oc);
+        if ( !visit(head->c[i], &oc, lc, qu) )
+            continue;
+        if ( !qu->half && maxd(qu->q->val, &oc, lc) < qu->r_sq )
+            num += head->c[i]->n - inside(qu->q->val, &oc, lc);
+        else
+            num += cnt( head->c[i], &oc, lc, qu );
+    }
+
+    return num;
+}
+
+
+/* put - write original indices of the query's result in head's subtree into
+ * out, see cnt
+ *
+ * Returns
+ * =======
+ * pointer behind last written index
+ *
+ */
+static size_t *put( const Node *head, const Value *o, unsigned int len,
+                    const query_t *qu, size_t *out )
+{
+    uint8_t i;
+    unsigned int lc;
+    Value oc;
+
+    if ( head->i ) {
+        if ( take(head->i, qu) )
+            *out++ = head->i->idx;
+        return out;
+    }
+    if ( !head->c )
+        return out;
+
+    for ( i = 0; i < NOC; ++i ) {
+        if ( !head->c[i] )
+            continue;
+        lc = child_cell(o, len, i, &oc);
+        if ( visit(head->c[i], &oc, lc, qu) )
+            out = put( head->c[i], &oc, lc, qu, out );
+    }
+
+    return out;
+}
+
+
+/* csr_alloc
+ * allocate offsets of csr for n rows, set to 0
+ *
+ */
+static void csr_alloc( CSR *csr, size_t n )
+{
+    size_t i;
+
+    csr->n          = n;
+    csr->offsets    = xmalloc(sizeof(size_t) * (n+1));
+    csr->indices    = NULL;
+    for ( i = 0; i <= n; ++i )
+        csr->offsets[i] = 0;
+}
+
+
+/* csr_scan
+ * turn counts (stored at offsets[i+1] for row i) into offsets by computing
+ * their prefix sum and allocate indices
+ *
+ */
+static void csr_scan( CSR *csr )
+{
+    size_t i;
+
+    for ( i = 0; i < csr->n; ++i )
+        csr->offsets[i+1] += csr->offsets[i];
+    csr->indices = xmalloc(sizeof(size_t) * (csr->offsets[csr->n] + 1));
+}
+
+
+/* arguments of the passes of pairs_radius over a range of items */
+typedef struct pargs_s {
+    const Node *head;
+    Value o;            /* origin of head's cell */
+    unsigned int len;   /* edge length of head's cell */
+    const Item *items;
+    double r_sq;
+    int half;
+    CSR *out;
+} pargs_t;
+
+
+/* count_task - counting pass for items in [b, e); rows are disjoint, so
+ * several threads may run it at once */
+static void count_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    pargs_t *pa     = (pargs_t *)ctx;
+    query_t qu      = { NULL, pa->r_sq, pa->half };
+    (void) tid;
+
+    for ( ; b < e; ++b ) {
+        qu.q = &pa->items[b];
+        pa->out->offsets[qu.q->idx + 1] = cnt( pa->head, &pa->o, pa->len, &qu );
+    }
+}
+
+
+/* fill_task - filling pass for items in [b, e), see count_task */
+static void fill_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    pargs_t *pa     = (pargs_t *)ctx;
+    query_t qu      = { NULL, pa->r_sq, pa->half };
+    (void) tid;
+
+    for ( ; b < e; ++b ) {
+        qu.q = &pa->items[b];
+        put( pa->head, &pa->o, pa->len, &qu,
+             pa->out->indices + pa->out->offsets[qu.q->idx] );
+    }
+}
+
+
+/* pargs_init
+ * set up arguments of both passes and allocate offsets of out
+ *
+ */
+static void pargs_init( pargs_t *pa, const Node *head, const Item *items,
+                        size_t size, double r_sq, int half, CSR *out )
+{
+    pa->head    = head;
+    pa->len     = cell(head, &pa->o);
+    pa->items   = items;
+    pa->r_sq    = r_sq;
+    pa->half    = half;
+    pa->out     = out;
+    csr_alloc( out, size );
+}
+
+
+/* pairs_radius
+ * for every item find all other items with a distance less than r
+ *
+ * Params
+ * ======
+ * head, Node *    :   root of tree built from items
+ * items, Item *   :   items of the tree, as returned by build_morton
+ * size, size_t    :   number of items
+ * r_sq, double    :   squared radius
+ * half, int       :   if set, each unordered pair is emitted once, i.e. only
+ *                     into the row of the item coming first in Morton order;
+ *                     cells before the query are not searched at all
+ * out, CSR *      :   result, rows are in the original order (i.e. by
+ *                     Item.idx); free with csr_free
+ *
+ */
+void pairs_radius( const Node *head, const Item *items, size_t size,
+                   double r_sq, int half, CSR *out )
+{
+    pargs_t pa;
+
+    pargs_init( &pa, head, items, size, r_sq, half, out );
+    count_task( 0, size, 0, &pa );
+    csr_scan( out );
+    fill_task( 0, size, 0, &pa );
+}
+
+
+/* pairs_radius_concurrent
+ * like pairs_radius, but both passes are distributed over several threads;
+ * each thread fetches contiguous chunks of the Morton ordered items (so that
+ * consecutive queries descend the same paths of the tree) until none are
+ * left, which balances skewed data. Since every row of out is written by
+ * exactly one query, no thread-local buffers or locks are necessary.
+ *
+ * Params
+ * ======
+ * head, items, size, r_sq, half, out  :   see pairs_radius
+ * nthreads, unsigned int              :   number of threads (0: one per
+ *                                         processor)
+ *
+ */
+void pairs_radius_concurrent( const Node *head, const Item *items, size_t size,
+                              double r_sq, int half, unsigned int nthreads,
+                              CSR *out )
+{
+    pargs_t pa;
+
+    pargs_init( &pa, head, items, size, r_sq, half, out );
+    parallel_for( size, 0, nthreads, count_task, &pa );
+    csr_scan( out );
+    parallel_for( size, 0, nthreads, fill_task, &pa );
+}
+
+
+/* state of the dual-tree traversal
+ *
+ * Members
+ * =======
+ * r_sq, double        :   squared radius
+ * half, int           :   whether to emit only pairs (a, b) with a before b
+ * out, CSR *          :   result
+ * cursor, size_t *    :   next free position of each row in out->indices;
+ *                         NULL in the counting pass
+ *
+ */
+typedef struct dual_s {
+    double r_sq;
+    int half;
+    CSR *out;
+    size_t *cursor;
+} dual_t;
+
+
+/* emit - count or write pair (a, b) into row of a */
+static inline void emit( dual_t *d, const Item *a, const Item *b )
+{
+    if ( d->cursor )
+        d->out->indices[d->cursor[a->idx]++] = b->idx;
+    else
+        ++d->out->offsets[a->idx + 1];
+}
+
+
+/* dual
+ * walk the tree against itself: pairs of nodes, whose cells are farther apart
+ * than r, are pruned; if the cells are completely within r of each other, no
+ * further distance checks are done (inside != 0); otherwise the node with
+ * the larger cell (or both, if they are on the same level) is split.
+ * Nodes of a pair are either identical or disjoint; in half mode, only the
+ * pairs of children (i, j) with i <= j of identical nodes are visited, so
+ * that the cell of a is always before the one of b in Morton order.
+ *
+ * Params
+ * ======
+ * a, b, Node *            :   pair of nodes; items of a are the rows, items of
+ *                             b the neighbours
+ * oa, ob, Value *         :   origins of their cells
+ * la, lb, unsigned int    :   edge lengths of their cells
+ * inside, int             :   whether a and b are known to be within r
+ * d, dual_t *             :   state of traversal
+ *
+ */
+static void dual( const Node *a, const Value *oa, unsigned int la,
+                  const Node *b, const Value *ob, unsigned int lb,
+                  int inside, dual_t *d )
+{
+    uint8_t i, j;
+    unsigned int lc, ld;
+    Value oc, od;
+
+    /* pair of leaves: checking the items is cheaper than their cells */
+    if ( a->i && b->i ) {
+        if ( a->i != b->i
+                && (inside || METRIC(a->i->val, b->i->val) < d->r_sq) )
+            emit( d, a->i, b->i );
+        return;
+    }
+
+    if ( !inside ) {
+        if ( mind_cells(oa, la, ob, lb) >= d->r_sq )
+            return;
+        inside = maxd_cells(oa, la, ob, lb) < d->r_sq;
+    }
+    /* vacated by refit */
+    if ( !(a->i || a->c) || !(b->i || b->c) )
+        return;
+
+    if ( b->i || (a->c && a->lvl < b->lvl) ) {
+        for ( i = 0; i < NOC; ++i ) {
+            if ( !a->c[i] )
+                continue;
+            lc = child_cell(oa, la, i, &oc);
+            dual( a->c[i], &oc, lc, b, ob, lb, inside, d );
+        }
+    } else if ( a->i || b->lvl < a->lvl ) {
+        for ( j = 0; j < NOC; ++j ) {
+            if ( !b->c[j] )
+                continue;
+            ld = child_cell(ob, lb, j, &od);
+            dual( a, oa, la, b->c[j], &od, ld, inside, d );
+        }
+    } else {
+        for ( i = 0; i < NOC; ++i ) {
+            if ( !a->c[i] )
+                continue;
+            lc = child_cell(oa, la, i, &oc);
+            for ( j = (d->half && a == b) ? i : 0; j < NOC; ++j ) {
+                if ( !b->c[j] )
+                    continue;
+                ld = child_cell(ob, lb, j, &od);
+                dual( a->c[i], &oc, lc, b->c[j], &od, ld, inside, d );
+            }
+        }
+    }
+}
+
+
+/* pairs_dualtree
+ * same result as pairs_radius (up to the order inside of each row), but
+ * instead of one descent from the root per item, the tree is traversed
+ * against itself (see dual), so that pruning decisions are shared between
+ * all items of a node
+ *
+ * Params
+ * ======
+ * head, Node *    :   root of tree
+ * size, size_t    :   number of items in tree
+ * r_sq, double    :   squared radius
+ * half, int       :   emit each unordered pair only once, see pairs_radius;
+ *                     halves the number of visited pairs of nodes
+ * out, CSR *      :   result, see pairs_radius
+ *
+ */
+void pairs_dualtree( const Node *head, size_t size, double r_sq, int half,
+                     CSR *out )
+{
+    size_t i;
+    unsigned int len;
+    Value o;
+    dual_t d = { r_sq, half, out, NULL };
+
+    csr_alloc( out, size );
+    len = cell(head, &o);
+
+    /* counting pass */
+    dual( head, &o, len, head, &o, len, 0, &d );
+
+    csr_scan( out );
+
+    /* filling pass */
+    d.cursor = xmalloc(sizeof(size_t) * size);
+    for ( i = 0; i < size; ++i )
+        d.cursor[i] = out->offsets[i];
+    dual( head, &o, len, head, &o, len, 0, &d );
+    free(d.cursor);
+}
+
+
+/* csr_free
+ * free buffers of given CSR and set its size to 0
+ *
+ */
+void csr_free( CSR *csr )
+{
+    free(csr->offsets);
+    free(csr->indices);
+    csr->offsets = csr->indices = NULL;
+    csr->n = 0;
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -0,0 +1,124 @@
+/* Minimal thread pool on top of POSIX threads: the index range [0, n) is
+ * split into chunks which the workers fetch from a shared atomic counter, so
+ * that skewed workloads are balanced dynamically.
+ *
+ * REQUIRES POSIX
+ *
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "parallel.h"
+#include "xmalloc.h"
+
+
+typedef struct pfor_s {
+    size_t n, chunk;
+    atomic_size_t next;     /* beginning of next chunk to process */
+    task_fptr_t task;
+    void *ctx;
+} pfor_t;
+
+typedef struct worker_s {
+    pfor_t *pf;
+    unsigned int tid;
+} worker_t;
+
+
+/* work
+ * fetch and process chunks until the range is exhausted
+ *
+ */
+static void *work( void *arg )
+{
+    worker_t *w = (worker_t *)arg;
+    pfor_t *pf  = w->pf;
+    size_t b, e;    /* begin, end */
+
+    while ( (b = atomic_fetch_add(&pf->next, pf->chunk)) < pf->n ) {
+        e = (pf->n - b > pf->chunk) ? b + pf->chunk : pf->n;
+        (*pf->task)( b, e, w->tid, pf->ctx );
+    }
+
+    return NULL;
+}
+
+
+/* num_threads
+ *
+ * Params
+ * ======
+ * nthreads, unsigned int  :   requested number of threads
+ *
+ * Returns
+ * =======
+ * nthreads, or the number of online processors if nthreads == 0
+ *
+ */
+unsigned int num_threads( unsigned int nthreads )
+{
+    long np;
+
+    if ( nthreads )
+        return nthreads;
+    np = sysconf(_SC_NPROCESSORS_ONLN);
+    return np > 0 ? (unsigned int)np : 1;
+}
+
+
+/* parallel_for
+ * call task on chunks of [0, n) using nthreads threads (including the calling
+ * one); returns when all chunks are processed
+ *
+ * Params
+ * ======
+ * n, size_t               :   size of index range
+ * chunk, size_t           :   number of indices per chunk (0: choose
+ *                             automatically)
+ * nthreads, unsigned int  :   number of threads (0: one per processor)
+ * task, task_fptr_t       :   function to call on each chunk
+ * ctx, void *             :   passed to task
+ *
+ */
+void parallel_for( size_t n, size_t chunk, unsigned int nthreads,
+                   task_fptr_t task, void *ctx )
+{
+    unsigned int i, started;
+    pthread_t *threads;
+    worker_t *workers;
+    pfor_t pf;
+
+    nthreads = num_threads(nthreads);
+    if ( !chunk )
+        chunk = n / (8 * nthreads) + 1;
+
+    pf.n        = n;
+    pf.chunk    = chunk;
+    pf.task     = task;
+    pf.ctx      = ctx;
+    atomic_init(&pf.next, 0);
+
+    threads = xmalloc(sizeof(pthread_t) * nthreads);
+    workers = xmalloc(sizeof(worker_t) * nthreads);
+
+    /* thread 0 is the calling thread; if creating a thread fails, the
+     * remaining ones pick up its work */
+    for ( i = 0; i < nthreads; ++i ) {
+        workers[i].pf   = &pf;
+        workers[i].tid  = i;
+    }
+    for ( started = 1; started < nthreads; ++started )
+        if ( pthread_create(&threads[started], NULL, work, &workers[started]) )
+            break;
+
+    work(&workers[0]);
+
+    for ( i = 1; i < started; ++i )
+        pthread_join(threads[i], NULL);
+
+    free(workers);
+    free(threads);
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -1,7 +1,9 @@
 #include <assert.h>
 #include <math.h>
+#include <stdatomic.h>
 #include "quadtree.h"
 #include "morton.h"
+#include "parallel.h"
 
 
 /* lookup table for msb */
@@ -48,6 +50,9 @@ static const key_t suffixes[8][3] = {
     { 0x1, 0xDEAD },        { 0x0, 0xDEAD }
 };
 
+/* all directions, i.e. the whole subtree */
+static const key_t all_dirs[5] = { 0x0, 0x1, 0x2, 0x3, 0xDEAD };
+
 
 
 /* msb - most significant bit
@@ -91,6 +96,24 @@ static inline key_t bap( key_t k, lvl_t j, lvl_t l )
 }
 
 
+/* common
+ * level of the deepest cell containing both key a on level la and key b on
+ * level lb
+ *
+ */
+static inline lvl_t common( key_t a, lvl_t la, key_t b, lvl_t lb )
+{
+    lvl_t l;
+    key_t diff = (key_t)(a << DIM * (maxlvl - la))
+               ^ (key_t)(b << DIM * (maxlvl - lb));
+
+    l = diff ? maxlvl - msb(diff) / DIM - 1 : maxlvl;
+    if ( l > la )
+        l = la;
+    return l < lb ? l : lb;
+}
+
+
 /* make_node
  * construct a new Node-instance and return its pointer
  *
@@ -100,13 +123,15 @@ static inline key_t bap( key_t k, lvl_t j, lvl_t l )
  * i, Item *       :    item to store in item (or NULL)
  * lvl, lvl_t      :    level of new Node
  * c, Node **      :    children (or NULL)
+ * p, Node *       :    parent (or NULL)
  *
  * Returns
  * =======
  * Node * to newly created object
  *
  */
-static inline Node *make_node( key_t key, const Item *i, lvl_t lvl, Node **c )
+static inline Node *make_node( key_t key, const Item *i, lvl_t lvl, Node **c,
+                               Node *p )
 {
     Node *nn;   /* new node */
     nn      = xmalloc(sizeof(Node));
@@ -114,6 +139,8 @@ static inline Node *make_node( key_t key, const Item *i, lvl_t lvl, Node **c )
     nn->i   = i;
     nn->lvl = lvl;
     nn->c   = c;
+    nn->p   = p;
+    nn->n   = i ? 1 : 0;
     nn->allocated = 1;
     return nn;
 }
@@ -135,6 +162,79 @@ static inline Node **make_children( void )
 }
 
 
+/* make_root
+ * create the root node for a tree holding the given (sorted) items: instead
+ * of covering the whole key space, the root is the cell given by the common
+ * prefix of the first and the last key (and thereby of all keys), so that
+ * clustered data doesn't pay for useless levels at the top of the tree
+ *
+ * Params
+ * ======
+ * first, last, Item * :   smallest and largest item to be inserted
+ *
+ * Returns
+ * =======
+ * Node * to root with allocated children
+ *
+ */
+static inline Node *make_root( const Item *first, const Item *last )
+{
+    lvl_t lvl;
+
+    /* `first XOR last` sets to one the bits which differ */
+    lvl = (first->key == last->key) ? maxlvl
+        : maxlvl - msb(first->key ^ last->key) / 2 - 1;
+    /* the root has children, so it must not be on the lowest level */
+    if ( lvl == maxlvl )
+        lvl = maxlvl - 1;
+
+    return make_node( first->key >> DIM * (maxlvl - lvl), NULL, lvl,
+                      make_children(), NULL );
+}
+
+
+/* outside
+ * check whether key on level lvl lies outside of head's cell
+ *
+ */
+static inline int outside( key_t key, lvl_t lvl, const Node *head )
+{
+    return (key >> DIM * (lvl - head->lvl)) != head->key;
+}
+
+
+/* grow_root
+ * move root up until its cell contains the given key: the content of head is
+ * moved into a new child, head is turned into its parent
+ *
+ * Returns
+ * =======
+ * number of newly created nodes
+ *
+ */
+static lvl_t grow_root( Node *head, key_t key )
+{
+    lvl_t num = 0;
+    uint8_t i;
+    Node *nn;
+
+    while ( outside(key, maxlvl, head) ) {
+        nn = make_node( head->key, head->i, head->lvl, head->c, head );
+        for ( i = 0; nn->c && i < NOC; ++i )
+            if ( nn->c[i] )
+                nn->c[i]->p = nn;
+        head->lvl   -= 1;
+        head->key  >>= DIM;
+        head->i      = NULL;
+        head->c      = make_children();
+        head->c[nn->key & MASK] = nn;
+        ++num;
+    }
+
+    return num;
+}
+
+
 /* build_branch
  * build whole branch until the node specified by key is reached, starting
  * at head with a depth of nl
@@ -144,13 +244,14 @@ static inline Node **make_children( void )
  * cl, lvl_t       :   current level, at which to start building the branch
  * nl, lvl_t       :   number of new level
  * item, Item *    :   key-value-pair of final node in new branch
+ * p, Node *       :   parent of new branch
  *
  * Returns
  * =======
  * Node pointer to new branch
  *
  */
-static Node *build_branch( lvl_t cl, lvl_t nl, const Item *item )
+static Node *build_branch( lvl_t cl, lvl_t nl, const Item *item, Node *p )
 {
     lvl_t i;
     Node *nn;   /* new nodes */
@@ -175,6 +276,8 @@ static Node *build_branch( lvl_t cl, lvl_t nl, const Item *item )
         nn[i].i         = NULL;
         nn[i].lvl       = cl + i;
         nn[i].key       = item->key >> DIM * (maxlvl - nn[i].lvl);
+        nn[i].p         = i ? &nn[i-1] : p;
+        nn[i].n         = 1;
         nn[i].allocated = 0;
     }
 
@@ -188,7 +291,11 @@ static Node *build_branch( lvl_t cl, lvl_t nl, const Item *item )
 }
 
 
-/* scr - search children recursivly
+/* scr - search children
+ * collect the leaves of head's subtree, which are reachable by only going into
+ * the directions given by suffix; the traversal is iterative, using an
+ * explicit stack, and yields the leaves in the same (depth first) order as a
+ * recursion would
  *
  * Params
  * ======
@@ -196,21 +303,29 @@ static Node *build_branch( lvl_t cl, lvl_t nl, const Item *item )
  * suffix, key_t *     :   relevant search directions, terminated by 0xDEAD
  * res, DArray_Item *  :   Array in which to write result
  *
- * TODO: is there a more elegant way of implementing this function?
- *
  */
 static void scr( const Node *head, const key_t *suffix, DArray_Item *res )
 {
-    const key_t *suffix_orig = suffix;
+    /* each level adds at most (number of directions - 1) pending nodes */
+    const Node *stack[(NOC-1) * MAXLVL + 1];
+    uint8_t top = 0, ns, k;
+    const Node *c;
 
-    if ( head->i ) {
-        assert( head->c == NULL );
-        DArray_Item_append(res, head->i);
-    } else {
-        while ( *suffix != 0xDEAD ) {
-            if ( head->c[*suffix] )
-                scr( head->c[*suffix], suffix_orig, res );
-            ++suffix;
+    for ( ns = 0; suffix[ns] != 0xDEAD; ++ns )
+        ;
+
+    stack[top++] = head;
+    while ( top ) {
+        head = stack[--top];
+        if ( head->i ) {
+            assert( head->c == NULL );
+            DArray_Item_append(res, head->i);
+        } else if ( head->c ) {     /* skip nodes vacated by refit */
+            /* push in reverse order, so that the first direction is popped
+             * first */
+            for ( k = ns; k-- > 0; )
+                if ( (c = head->c[suffix[k]]) )
+                    stack[top++] = c;
         }
     }
 }
@@ -219,10 +334,12 @@ static void scr( const Node *head, const key_t *suffix, DArray_Item *res )
 /* build_tree
  * convenience function: creates root node and inserts each element from given
  * items-array
+ * the root is placed at the cell of the common prefix of all keys (see
+ * make_root), i.e. head->lvl might be > 0
  *
  * Params
  * ======
- * items, Item*    :   array for items to insert in tree
+ * items, Item*    :   array for items to insert in tree, sorted by key
  * insert_fptr     :   pointer to insert function
  *                     signature: lvl_t insert(const Node *, const Item *)
  *
@@ -234,16 +351,94 @@ static void scr( const Node *head, const key_t *suffix, DArray_Item *res )
  */
 Node *build_tree( const Item *items, lvl_t (*insert_fptr)(Node *, const Item *) )
 {
-    Node *head = make_node(0, NULL, 0, make_children());
+    const Item *last;
+    Node *head;
+
+    for ( last = items; !last->last; ++last )
+        ;
+    head = make_root( items, last );
 
     (*insert_fptr)( head, items );
     while ( !items->last )
         (*insert_fptr)( head, ++items );
+    count_items( head );
 
     return head;
 }
 
 
+typedef struct bargs_s {
+    Node *head;
+    const Item *items;
+} bargs_t;
+
+static void insert_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    bargs_t *ba = (bargs_t *)ctx;
+    (void) tid;
+    for ( ; b < e; ++b )
+        insert_concurrent( ba->head, &ba->items[b] );
+}
+
+
+/* build_tree_concurrent
+ * like build_tree, but the items are inserted by several threads at once
+ * using insert_concurrent
+ *
+ * Params
+ * ======
+ * items, Item *           :   array of items to insert, sorted by key
+ * size, size_t            :   number of items
+ * nthreads, unsigned int  :   number of threads (0: one per processor)
+ *
+ * Returns
+ * =======
+ * Node pointer to root node of newly created tree (without items and covering
+ *     the whole key space if size == 0)
+ *
+ */
+Node *build_tree_concurrent( const Item *items, size_t size,
+                             unsigned int nthreads )
+{
+    bargs_t ba;
+
+    if ( !size )
+        return make_node( 0, NULL, 0, make_children(), NULL );
+
+    ba.head     = make_root( &items[0], &items[size-1] );
+    ba.items    = items;
+
+    parallel_for( size, 0, nthreads, insert_task, &ba );
+    count_items( ba.head );
+
+    return ba.head;
+}
+
+
+/* count_items
+ * set the item count n of every node in head's subtree (bottom-up); done by
+ * build_tree, build_tree_concurrent and refit, call it after inserting items
+ * by hand
+ *
+ * Returns
+ * =======
+ * number of items in head's subtree
+ *
+ */
+size_t count_items( Node *head )
+{
+    uint8_t i;
+
+    head->n = head->i ? 1 : 0;
+    if ( head->c )
+        for ( i = 0; i < NOC; ++i )
+            if ( head->c[i] )
+                head->n += count_items( head->c[i] );
+
+    return head->n;
+}
+
+
 /* cleanup
  *
  * Params
@@ -313,7 +508,7 @@ lvl_t insert_fast( Node *head, const Item *items )
         }
         /* number of new levels */
         nl = (lcl - head->lvl > 0) ? lcl - head->lvl : 1;
-        head->c[sb] = build_branch( head->lvl+1, nl, items );
+        head->c[sb] = build_branch( head->lvl+1, nl, items, head );
 
         return nl;
     }
@@ -353,7 +548,7 @@ lvl_t insert_simple( Node *head, const Item *item )
         return insert_simple(head->c[sb], item);
     }
 
-    tmp = make_node( (head->key << DIM) | sb, item, head->lvl+1, NULL );
+    tmp = make_node( (head->key << DIM) | sb, item, head->lvl+1, NULL, head );
     if ( head->c ) {
         head->c[sb] = tmp;
         return 1;
@@ -368,7 +563,8 @@ lvl_t insert_simple( Node *head, const Item *item )
         if ( head->c[sb] ) {
             num = 1 + insert_simple(head->c[sb], head->i);
         } else {
-            tmp = make_node( (head->key << DIM) | sb, head->i, head->lvl+1, NULL );
+            tmp = make_node( (head->key << DIM) | sb, head->i, head->lvl+1,
+                             NULL, head );
             head->c[sb] = tmp;
             num = 2;
         }
@@ -379,6 +575,233 @@ lvl_t insert_simple( Node *head, const Item *item )
 }
 
 
+/* atomic access to the pointers of a node which are shared between threads in
+ * insert_concurrent; the non-atomic members are accessed through atomic
+ * pointers, so that single-threaded code does not pay for the atomics */
+static inline Node *load_child( Node **slot )
+{
+    return atomic_load( (_Atomic(Node *) *)slot );
+}
+
+static inline int cas_child( Node **slot, Node *nn )
+{
+    Node *expected = NULL;
+    return atomic_compare_exchange_strong( (_Atomic(Node *) *)slot,
+                                           &expected, nn );
+}
+
+static inline Node **load_children( Node *n )
+{
+    return atomic_load( (_Atomic(Node **) *)&n->c );
+}
+
+static inline int cas_children( Node *n, Node **c )
+{
+    Node **expected = NULL;
+    return atomic_compare_exchange_strong( (_Atomic(Node **) *)&n->c,
+                                           &expected, c );
+}
+
+
+/* free_children
+ * free array of children and their subtrees (e.g. a branch which was built,
+ * but could not be linked into the tree)
+ *
+ */
+static void free_children( Node **c )
+{
+    uint8_t i;
+    for ( i = 0; i < NOC; ++i )
+        if ( c[i] )
+            cleanup(c[i]);
+    free(c);
+}
+
+
+/* split_leaf
+ * build children for a leaf at level cl, which are requiered to hold its item
+ * a and the new item b, i.e. a chain of nodes until a and b differ
+ *
+ * Params
+ * ======
+ * cl, lvl_t       :   level of leaf to split
+ * a, b, Item *    :   its current and the new item
+ * num, lvl_t *    :   number of newly created nodes is added to it
+ * p, Node *       :   the leaf, parent of the new children
+ *
+ * Returns
+ * =======
+ * Node ** to children of leaf
+ *
+ */
+static Node **split_leaf( lvl_t cl, const Item *a, const Item *b, lvl_t *num,
+                          Node *p )
+{
+    key_t sa, sb;
+    Node **c = make_children();
+
+    assert( cl != maxlvl );     /* don't allow multiple items per node */
+    sa = bap(a->key, cl+1, maxlvl);
+    sb = bap(b->key, cl+1, maxlvl);
+
+    if ( sa != sb ) {
+        c[sa] = make_node( a->key >> DIM * (maxlvl-cl-1), a, cl+1, NULL, p );
+        c[sb] = make_node( b->key >> DIM * (maxlvl-cl-1), b, cl+1, NULL, p );
+        *num += 2;
+    } else {
+        c[sa] = make_node( a->key >> DIM * (maxlvl-cl-1), NULL, cl+1, NULL, p );
+        c[sa]->c = split_leaf( cl+1, a, b, num, c[sa] );
+        *num += 1;
+    }
+
+    return c;
+}
+
+
+/* insert_concurrent
+ * thread-safe and lock-free insertion, may be called by several threads on
+ * the same tree at the same time
+ *
+ * Empty child slots are claimed with compare-and-swap; an occupied leaf is
+ * split by building its new children privately and swapping them into the
+ * leaf's (NULL) children pointer, afterwards its item is cleared. If a CAS
+ * fails, another thread was faster and the insertion is retried from the
+ * winning node.
+ *
+ * NOTICE: all items must lie in head's cell; no other function may access
+ *     the tree during concurrent insertion
+ *
+ * Params see insert_simple
+ * Returns number of newly created nodes
+ *
+ */
+lvl_t insert_concurrent( Node *head, const Item *item )
+{
+    key_t sb;
+    lvl_t num;
+    Node *child, **c;
+    const Item *other;
+
+    while ( 1 ) {
+        /* head has children here */
+        assert( head->lvl != maxlvl );
+        sb = bap(item->key, head->lvl+1, maxlvl);
+        child = load_child( &head->c[sb] );
+
+        /* empty slot: claim it with a new leaf */
+        if ( child == NULL ) {
+            child = make_node( item->key >> DIM * (maxlvl-head->lvl-1), item,
+                               head->lvl+1, NULL, head );
+            if ( cas_child(&head->c[sb], child) )
+                return 1;
+            free(child);    /* lost, retry at the same node */
+            continue;
+        }
+
+        /* inner node: descend */
+        if ( load_children(child) ) {
+            head = child;
+            continue;
+        }
+
+        other = atomic_load( (_Atomic(const Item *) *)&child->i );
+        if ( other == NULL ) {
+            /* either child is being split (then its children are visible by
+             * now) or it was vacated by refit: claim it */
+            if ( load_children(child) )
+                continue;
+            if ( atomic_compare_exchange_strong(
+                        (_Atomic(const Item *) *)&child->i, &other, item ) )
+                return 0;
+            continue;
+        }
+
+        /* leaf: split it */
+        num = 0;
+        c = split_leaf( child->lvl, other, item, &num, child );
+        if ( cas_children(child, c) ) {
+            atomic_store( (_Atomic(const Item *) *)&child->i, NULL );
+            return num;
+        }
+        free_children(c);
+        head = child;
+    }
+}
+
+
+/* refit
+ * update the tree after the values referenced by items have changed, instead
+ * of rebuilding it from scratch
+ * the keys of all items are recomputed; items which are still inside the cell
+ * of their leaf stay where they are, the others are removed from their leaf
+ * and reinserted with insert_simple
+ *
+ * NOTICE: if an item left the root's cell, the root is moved up accordingly.
+ *     The leaves of moved items are only vacated (i.e. `i == NULL` and
+ *     `c == NULL`), they are freed in cleanup and reused by later insertions.
+ *     Since the keys are changed in place, items is not sorted anymore; use
+ *     build_morton and build_tree, if Morton order is requiered
+ *
+ * Params
+ * ======
+ * head, Node *            :   root of the tree built from items
+ * items, Item *           :   items of the tree, the last one is marked with
+ *                             item->last == 1; their keys are updated
+ * stats, refit_stats_t *  :   if not NULL, write number of moved items and of
+ *                             touched (i.e. vacated or inserted) nodes into it;
+ *                             if stats->moved is large compared to the number
+ *                             of items, a full rebuild is probably cheaper
+ *
+ */
+void refit( Node *head, Item *items, refit_stats_t *stats )
+{
+    key_t nk;           /* new key */
+    size_t moved = 0, touched = 0;
+    Node *leaf;
+    DArray_Item out;    /* items which left their cell */
+    ItemIterator *it, *end;
+
+    DArray_Item_init(&out, 8);
+
+    /* first pass: update keys and vacate leaves of moved items; the search is
+     * done with the old key, so it is not affected by other moved items */
+    while ( 1 ) {
+        leaf = search( items->key, head, maxlvl );
+        assert( leaf->i == items );
+        nk = interleave(items->val->x, items->val->y);
+        items->key = nk;
+
+        if ( (nk >> DIM * (maxlvl - leaf->lvl)) != leaf->key ) {
+            leaf->i = NULL;
+            DArray_Item_append(&out, items);
+            ++touched;
+        }
+
+        if ( items->last )
+            break;
+        ++items;
+    }
+
+    /* second pass: reinsert moved items (insert_simple fills vacated nodes
+     * and splits occupied ones) */
+    it  = DArray_Item_start(&out);
+    end = DArray_Item_end(&out);
+    for ( ; it != end; ++it, ++moved ) {
+        touched += grow_root( head, (*it)->key );
+        touched += 1 + insert_simple( head, *it );
+    }
+
+    DArray_Item_free(&out);
+    if ( moved )
+        count_items( head );
+
+    if ( stats ) {
+        stats->moved    = moved;
+        stats->touched  = touched;
+    }
+}
+
+
 /* search - traverse tree until node without children or with given key is found
  *
  * Params
@@ -388,6 +811,9 @@ lvl_t insert_simple( Node *head, const Item *item )
  * lvl, lvl_t      :   level of searched node, i.e. 2*(length of key)
  *                     (might be < maxlvl for searching in incomplete trees)
  *
+ * NOTICE: key has to lie inside of head's cell (keep in mind, that the root
+ *     returned by build_tree doesn't necessarily cover the whole key space)
+ *
  * Returns
  * =======
  * Node pointer with the desired key or its deepest existing anchestor
@@ -406,36 +832,60 @@ Node *search( key_t key, Node *head, lvl_t lvl )
 }
 
 
-/* find_neighbours
- * to given key, compute keys of potential neighbours.
- * search quadtree for those candidates to see if they exists, otherwise take
- *     their deepest existing ancestor.
- * if the candidates itself has children, search for their end nodes facing into
- *     the direction of the current node (i.e. its neighbours).
+/* lookup
+ * search key on level lvl: if from is given, climb up from it until the cell
+ * contains the key; otherwise start at the cached path, if given, or at head
  *
- * Params
- * ======
- * key, key_t          :   key of node, whichs neighbours to search for
- * head, Node *        :   head of quadtree to search in
- * res, DArray_Value * :   Value array to write results into
- *                         Its first value is the Node of the given key (i.e. the
- *                             reference node), its neighbours start at index 1
+ */
+static inline Node *lookup( key_t key, Node *head, path_t *path,
+                            const Node *from, lvl_t lvl )
+{
+    lvl_t l;
+
+    if ( from ) {
+        l = common( key, lvl, from->key, from->lvl );
+        while ( from->lvl > l )
+            from = from->p;
+        return search( key, (Node *)from, lvl );
+    }
+    return path ? search_path( key, path, lvl ) : search( key, head, lvl );
+}
+
+
+/* append_unique
+ * append item to res, if it isn't already part of it
  *
- * NOTICE: You get the Values of neighbouring nodes. Depending on the actual shape
- *     of the quadtree, the distances between the reference and its neighbours might
- *     vary significantly (i.e. values in opposite corners of large nodes).
- *     Perhaps you want to filter out those values which are too far away
+ */
+static inline void append_unique( DArray_Item *res, const Item *item )
+{
+    ItemIterator *it, *end;
+
+    it      = DArray_Item_start(res);
+    end     = DArray_Item_end(res);
+    while ( it != end && item->key != (*it)->key )
+        ++it;
+    /* if it < end, the element was already found previously */
+    if ( it == end )
+        DArray_Item_append(res, item);
+}
+
+
+/* neighbours
+ * see find_neighbours; the reference node is leaf, if given, and is searched
+ * otherwise; searches use path, if it isn't NULL; if periodic is set, the
+ * candidates wrap around the domain's boundary
  *
  */
-void find_neighbours( key_t key, Node *head, DArray_Item *res )
+static void neighbours( key_t key, Node *head, path_t *path, Node *leaf,
+                        int periodic, DArray_Item *res )
 {
-    size_t i, tkey;
+    size_t i;
     uint8_t flag = 0;
     Node *c, *tmp;      /* current, temporary */
-    ItemIterator *it, *end;
+    key_t mask;
 
     /* find current node given by key, actual existing key is c->key */
-    c = search( key, head, maxlvl );
+    c = leaf ? leaf : lookup( key, head, path, NULL, maxlvl );
 
     /* candidate keys */
     key_t cand_keys[8] = {
@@ -445,20 +895,30 @@ void find_neighbours( key_t key, Node *head, DArray_Item *res )
         bot(left(c->key)),  bot(right(c->key))
     };
 
+    /* wrap around: keys modulo the number of cells on c's level */
+    if ( periodic ) {
+        mask = (key_t)((1u << DIM * c->lvl) - 1);
+        for ( i = 0; i < 8; ++i )
+            cand_keys[i] &= mask;
+    }
+
     /* overwrite res */
     res->_used = 0;
 
     /* iterate over directions left, right, top and bottom */
     for ( i = 0; i < 4; ++i ) {
-        /* if node is on boundary: skip */
+        /* if node is on boundary (of the domain or of the root's cell, which
+         * contains all items): skip */
         /* TODO: there is probably a more elegant way of doing this...  */
-        if ( (c->key & bnds[i][0]) == (bnds[i][1] >> 2*(maxlvl - c->lvl)) ) {
+        if ( (!periodic && (c->key & bnds[i][0])
+                    == (bnds[i][1] >> 2*(maxlvl - c->lvl)))
+                || outside(cand_keys[i], c->lvl, head) ) {
             flag |= 1 << i;
             continue;
         }
 
         /* find neighbour candidate node */
-        tmp = search( cand_keys[i], head, c->lvl );
+        tmp = lookup( cand_keys[i], head, path, leaf ? c : NULL, c->lvl );
 
         /* IF it is on the same level as the current node
          *  AND has further children: search them (write findings into res)
@@ -467,27 +927,342 @@ void find_neighbours( key_t key, Node *head, DArray_Item *res )
          * ELSE: write tmp into res */
         if ( tmp->lvl == c->lvl && tmp->c )
             scr( tmp, suffixes[i], res );
-        else if ( tmp->i )
-            DArray_Item_append(res, tmp->i);
+        else if ( tmp->i ) {
+            /* with two cells per dimension, left and right (or top and
+             * bottom) wrap around to the same cell */
+            if ( periodic )
+                append_unique( res, tmp->i );
+            else
+                DArray_Item_append(res, tmp->i);
+        }
     }
 
     /* iterate over diagonal directions */
     for ( i = 4; i < 8; ++i ) {
         if ( (flag & bnds[i][0]) )
             continue;
-        tmp = search( cand_keys[i], head, c->lvl );
+        tmp = lookup( cand_keys[i], head, path, leaf ? c : NULL, c->lvl );
         if ( tmp->lvl == c->lvl && tmp->c )
             scr( tmp, suffixes[i], res );
-        else if ( tmp->i ) {
-            /* check if element already exists */
-            tkey    = tmp->i->key;
-            it      = DArray_Item_start(res);
-            end     = DArray_Item_end(res);
-            while ( it != end && /* *it && */ tkey != (*it)->key )
-                ++it;
-            /* if it < end, the element was already found previously */
-            if ( it == end )
-                DArray_Item_append(res, tmp->i);
+        else if ( tmp->i )
+            append_unique( res, tmp->i );
+    }
+}
+
+
+/* find_neighbours
+ * to given key, compute keys of potential neighbours.
+ * search quadtree for those candidates to see if they exists, otherwise take
+ *     their deepest existing ancestor.
+ * if the candidates itself has children, search for their end nodes facing into
+ *     the direction of the current node (i.e. its neighbours).
+ *
+ * Params
+ * ======
+ * key, key_t          :   key of node, whichs neighbours to search for
+ * head, Node *        :   head of quadtree to search in (i.e. its root, since
+ *                         neighbours outside of head's cell are skipped)
+ * res, DArray_Value * :   Value array to write results into
+ *                         Its first value is the Node of the given key (i.e. the
+ *                             reference node), its neighbours start at index 1
+ *
+ * NOTICE: You get the Values of neighbouring nodes. Depending on the actual shape
+ *     of the quadtree, the distances between the reference and its neighbours might
+ *     vary significantly (i.e. values in opposite corners of large nodes).
+ *     Perhaps you want to filter out those values which are too far away
+ *
+ */
+void find_neighbours( key_t key, Node *head, DArray_Item *res )
+{
+    neighbours( key, head, NULL, NULL, 0, res );
+}
+
+
+/* path_init
+ * start a sequence of searches with search_path at the root head
+ *
+ */
+void path_init( path_t *path, Node *head )
+{
+    path->n[head->lvl]  = head;
+    path->lo            = head->lvl;
+    path->hi            = head->lvl;
+    path->lookups       = 0;
+    path->hits          = 0;
+}
+
+
+/* search_path
+ * like search, but instead of at the root, start at the deepest node on the
+ * previous search's path, which contains key; for queries in Morton order,
+ * consecutive keys mostly share long prefixes, so only the last few levels
+ * have to be descended
+ *
+ * Params
+ * ======
+ * key, key_t      :   key to look for, has to lie inside of the root's cell
+ * path, path_t *  :   path of previous search, is updated
+ * lvl, lvl_t      :   level of searched node, see search
+ *
+ * Returns
+ * =======
+ * see search
+ *
+ */
+Node *search_path( key_t key, path_t *path, lvl_t lvl )
+{
+    lvl_t l;
+    key_t sb;
+    Node *c;
+
+    l = common( key, lvl, path->n[path->hi]->key, path->hi );
+
+    ++path->lookups;
+    if ( l > path->lo )
+        ++path->hits;
+
+    c = path->n[l];
+    while ( c->c && c->c[(sb = bap(key, c->lvl+1, lvl))] && lvl != c->lvl ) {
+        c = c->c[sb];
+        path->n[c->lvl] = c;
+    }
+    path->hi = c->lvl;
+
+    return c;
+}
+
+
+/* find_neighbours_path
+ * same as find_neighbours, but all searches start on the path cached by the
+ * previous one (see search_path): that of the reference node as well as
+ * those of its neighbour candidates, which share their prefix with it up to
+ * their common ancestor. Meant for batches of queries in Morton order.
+ *
+ * Params
+ * ======
+ * key, key_t          :   see find_neighbours
+ * path, path_t *      :   initialised by path_init with the root of the tree;
+ *                         path->hits / path->lookups is the rate of reuse
+ * res, DArray_Item *  :   see find_neighbours
+ *
+ */
+void find_neighbours_path( key_t key, path_t *path, DArray_Item *res )
+{
+    neighbours( key, path->n[path->lo], path, NULL, 0, res );
+}
+
+
+/* index_rec - see index_leaves */
+static void index_rec( Node *head, const Item *items, Node **leaves )
+{
+    uint8_t i;
+
+    if ( head->i )
+        leaves[head->i - items] = head;
+    else if ( head->c )
+        for ( i = 0; i < NOC; ++i )
+            if ( head->c[i] )
+                index_rec( head->c[i], items, leaves );
+}
+
+
+/* index_leaves
+ * record the leaf of each item, as handles for find_neighbours_leaf
+ *
+ * Params
+ * ======
+ * head, Node *    :   root of tree built from items
+ * items, Item *   :   items of the tree
+ * size, size_t    :   number of items
+ *
+ * Returns
+ * =======
+ * array of size `size` (free after use), the leaf of items[k] is at k; it
+ * stays valid until the tree is modified
+ *
+ */
+Node **index_leaves( Node *head, const Item *items, size_t size )
+{
+    Node **leaves = xmalloc(sizeof(Node *) * size);
+
+    index_rec( head, items, leaves );
+    return leaves;
+}
+
+
+/* find_neighbours_leaf
+ * same as find_neighbours, but the reference node is given by its leaf
+ * (see index_leaves) instead of its key, so that there is no search from the
+ * root: for each neighbour candidate, the tree is climbed up via the parent
+ * links only to the common ancestor of leaf and candidate, and descended from
+ * there
+ *
+ * Params
+ * ======
+ * leaf, Node *        :   leaf of an item of the tree
+ * head, Node *        :   root of the tree
+ * res, DArray_Item *  :   see find_neighbours
+ *
+ */
+void find_neighbours_leaf( Node *leaf, Node *head, DArray_Item *res )
+{
+    neighbours( leaf->i->key, head, NULL, leaf, 0, res );
+}
+
+
+/* find_neighbours_periodic
+ * same as find_neighbours, but for a periodic domain: neighbours across the
+ * boundary of the domain wrap around (use METRIC_PERIODIC for distances)
+ *
+ * Params see find_neighbours
+ *
+ */
+void find_neighbours_periodic( key_t key, Node *head, DArray_Item *res )
+{
+    neighbours( key, head, NULL, NULL, 1, res );
+}
+
+
+/* probe_key
+ * key (on level maxlvl) of the value in head's cell nearest to q
+ *
+ */
+static inline key_t probe_key( const Value *q, const Node *head )
+{
+    unsigned int len = 256u >> head->lvl;
+    Value o = coords2(head->key << DIM * (maxlvl - head->lvl));
+    unsigned int x = q->x, y = q->y;
+
+    x = x < o.x ? o.x : (x >= o.x + len ? o.x + len - 1 : x);
+    y = y < o.y ? o.y : (y >= o.y + len ? o.y + len - 1 : y);
+
+    return interleave(x, y);
+}
+
+
+/* locate
+ * find the deepest node, whose cell contains the given value; the value need
+ * not be in the tree. If it lies outside of the root's cell, the nearest
+ * value inside of it is located instead.
+ *
+ * Params
+ * ======
+ * q, Value *      :   value to locate
+ * head, Node *    :   root of the tree
+ *
+ * Returns
+ * =======
+ * a leaf (whose item need not be q), a node vacated by refit or an inner
+ * node, whose child in direction of q doesn't exist
+ *
+ */
+Node *locate( const Value *q, Node *head )
+{
+    return search( probe_key(q, head), head, maxlvl );
+}
+
+
+/* find_neighbours_point
+ * like find_neighbours, but for a value which need not be in the tree (e.g. a
+ * fixed probe position): the reference cell is the one of the located node,
+ * or the empty child of it containing q, see locate. Unlike find_neighbours,
+ * the item of the reference cell (if any) is part of the result, at index 0.
+ * For exact queries use find_radius or knn, which accept any value as well.
+ *
+ * Params
+ * ======
+ * q, Value *          :   query value
+ * head, Node *        :   root of the tree
+ * res, DArray_Item *  :   result, is overwritten
+ *
+ */
+void find_neighbours_point( const Value *q, Node *head, DArray_Item *res )
+{
+    key_t key = probe_key(q, head);
+    Node *c = search( key, head, maxlvl );
+    Node empty = { 0, NULL, 0, NULL, 0, c, 0 };
+    ItemIterator *it;
+    const Item *own = c->i;
+
+    /* q lies in an empty cell below c */
+    if ( c->c ) {
+        empty.lvl   = c->lvl + 1;
+        empty.key   = key >> DIM * (maxlvl - empty.lvl);
+        c           = &empty;
+    }
+
+    neighbours( key, head, NULL, c, 0, res );
+    if ( own ) {
+        DArray_Item_append(res, own);
+        /* move it to the front */
+        for ( it = res->p + res->_used - 1; it != res->p; --it )
+            *it = *(it - 1);
+        *it = own;
+    }
+}
+
+
+/* find_neighbours_ring
+ * in contrast to find_neighbours, the result is complete for any radius: it
+ * contains every item with a distance less than r to the value of key (and
+ * possibly more, but no duplicates). The level L of the searched cells is the
+ * deepest one, for which `rings` cells in each direction cover r; then all
+ * cells of level L, which are at most that many cells away from the cell of
+ * key, are searched. An item is taken from a leaf above level L only if it
+ * lies in the searched cell, so that no item is found twice.
+ *
+ * Params
+ * ======
+ * key, key_t          :   key of the query, on level maxlvl
+ * head, Node *        :   root of the tree
+ * r_sq, double        :   squared radius
+ * rings, lvl_t        :   number of rings of cells around the cell of key
+ *                         (>= 1); more rings mean smaller cells and thereby
+ *                         fewer false positives, but more searches
+ * res, DArray_Item *  :   result, is overwritten; includes the item of key
+ *
+ */
+void find_neighbours_ring( key_t key, Node *head, double r_sq, lvl_t rings,
+                           DArray_Item *res )
+{
+    lvl_t l;
+    int dmax, len, m, cx, cy, x, y, n;
+    key_t ck;
+    Value q = coords2(key);
+    Node *c;
+
+    res->_used = 0;
+    if ( r_sq <= 0 )
+        return;
+
+    /* largest difference of coordinates within r */
+    dmax = (int)ceil(sqrt(r_sq)) - 1;
+    for ( l = maxlvl; l > 0 && rings * (256 >> l) < dmax; --l )
+        ;
+    /* cells above the root contain all items or none */
+    if ( l < head->lvl )
+        l = head->lvl;
+    len = 256 >> l;
+    m   = (dmax + len - 1) / len;
+    n   = 1 << l;           /* cells per dimension */
+    cx  = q.x / len;
+    cy  = q.y / len;
+
+    for ( y = cy - m; y <= cy + m; ++y ) {
+        if ( y < 0 || y >= n )
+            continue;
+        for ( x = cx - m; x <= cx + m; ++x ) {
+            if ( x < 0 || x >= n )
+                continue;
+            ck = interleave(x * len, y * len) >> DIM * (maxlvl - l);
+            if ( outside(ck, l, head) )
+                continue;
+
+            c = search( ck, head, l );
+            if ( c->lvl == l )
+                scr( c, all_dirs, res );
+            else if ( c->i && (c->i->key >> DIM * (maxlvl - l)) == ck )
+                DArray_Item_append(res, c->i);
         }
     }
 }
@@ -0,0 +1,563 @@
+/* This file contains queries on a quadtree built by build_tree, which take
+ * the geometry of the cells into account (in contrast to find_neighbours,
+ * which only considers adjacent cells).
+ */
+#include <math.h>
+#include "query.h"
+#include "visit.h"
+
+
+/* entry of the priority queues used in knn: either a node with the minimal
+ * distance of its cell or an item with its distance */
+typedef struct {
+    double d;
+    union {
+        const Node *n;
+        const Item *i;
+    } p;
+} Entry;
+
+/* workspace of knn, reused over consecutive queries
+ *
+ * Members
+ * =======
+ * q, Entry *          :   min-heap of nodes to visit, ordered by distance
+ * qn, qsize, size_t   :   used and available size of q
+ * r, Entry *          :   bounded max-heap of the k best items so far
+ * rn, k, size_t       :   used and available size of r
+ * scale, double       :   cells are pruned, if their squared distance is at
+ *                         least scale times the k-th best, i.e. 1/(1+eps)^2
+ * max_leaves, size_t  :   stop after visiting that many leaves (0: no limit)
+ * lower, double       :   lower bound of the squared distance of all items,
+ *                         which were not visited by the last search
+ *
+ */
+typedef struct {
+    Entry *q;
+    size_t qn, qsize;
+    Entry *r;
+    size_t rn, k;
+    double scale;
+    size_t max_leaves;
+    double lower;
+} knn_ws_t;
+
+
+/* all
+ * write items of all leaves in head's subtree into res
+ *
+ */
+static void all( const Node *head, DArray_Item *res )
+{
+    uint8_t i;
+
+    if ( head->i ) {
+        DArray_Item_append(res, head->i);
+    } else if ( head->c ) {
+        for ( i = 0; i < NOC; ++i )
+            if ( head->c[i] )
+                all( head->c[i], res );
+    }
+}
+
+
+/* radius_append - radius search appending every item within r to a DArray */
+RADIUS_VISITOR(radius_append, DArray_Item *,
+               (DArray_Item_append(ctx, item), 0))
+
+
+/* find_radius
+ * find all items, whose distance to the given value is less than r, by
+ * descending the tree and pruning cells by their minimal distance to q;
+ * cells which lie completely inside the radius are added without checking
+ * their items.
+ * In contrast to find_neighbours, the result is exact for any r.
+ *
+ * Params
+ * ======
+ * q, Value *          :   query value (need not be in the tree); if it is,
+ *                         its item is part of the result
+ * r_sq, double        :   squared radius, i.e. find items with
+ *                         METRIC(q, item->val) < r_sq
+ * head, Node *        :   root of quadtree to search in
+ * res, DArray_Item *  :   Array to write results into (is overwritten)
+ *
+ */
+void find_radius( const Value *q, double r_sq, const Node *head,
+                  DArray_Item *res )
+{
+    res->_used = 0;
+    radius_append( q, r_sq, head, res );
+}
+
+
+/* rng - recursive part of range_query, o and len give head's cell */
+static void rng( const Node *head, const Value *o, unsigned int len,
+                 const Value *lo, const Value *hi, DArray_Item *res )
+{
+    uint8_t i;
+    unsigned int lc;
+    Value oc;
+
+    if ( head->i ) {
+        if ( head->i->val->x >= lo->x && head->i->val->x <= hi->x
+                && head->i->val->y >= lo->y && head->i->val->y <= hi->y )
+            DArray_Item_append(res, head->i);
+        return;
+    }
+    if ( !head->c )     /* vacated by refit */
+        return;
+
+    for ( i = 0; i < NOC; ++i ) {
+        if ( !head->c[i] )
+            continue;
+        lc = child_cell(o, len, i, &oc);
+        /* no intersection */
+        if ( oc.x > hi->x || oc.x + lc - 1 < lo->x
+                || oc.y > hi->y || oc.y + lc - 1 < lo->y )
+            continue;
+        /* cell completely inside */
+        if ( oc.x >= lo->x && oc.x + lc - 1 <= hi->x
+                && oc.y >= lo->y && oc.y + lc - 1 <= hi->y )
+            all( head->c[i], res );
+        else
+            rng( head->c[i], &oc, lc, lo, hi, res );
+    }
+}
+
+
+/* range_query
+ * find all items inside of the axis-aligned box [xmin, xmax] x [ymin, ymax]
+ * (bounds included): only children whose cells intersect the box are
+ * descended, subtrees whose cells lie completely inside of it are added
+ * without checking their items
+ *
+ * Params
+ * ======
+ * head, Node *            :   root of quadtree to search in
+ * xmin, ymin, lvl_t       :   lower corner of box
+ * xmax, ymax, lvl_t       :   upper corner of box
+ * res, DArray_Item *      :   Array to write results into (is overwritten);
+ *                             items are in Morton order
+ *
+ */
+void range_query( const Node *head, lvl_t xmin, lvl_t ymin, lvl_t xmax,
+                  lvl_t ymax, DArray_Item *res )
+{
+    Value o, lo = { xmin, ymin }, hi = { xmax, ymax };
+    unsigned int len = cell(head, &o);
+
+    res->_used = 0;
+    if ( xmin > xmax || ymin > ymax )
+        return;
+    if ( o.x > hi.x || o.x + len - 1 < lo.x
+            || o.y > hi.y || o.y + len - 1 < lo.y )
+        return;
+    rng( head, &o, len, &lo, &hi, res );
+}
+
+
+/* crad - recursive part of count_radius, see RADIUS_VISITOR */
+static size_t crad( const Node *head, const Value *q, double r_sq )
+{
+    uint8_t i;
+    unsigned int len;
+    size_t num = 0;
+    Value o;
+    const Node *n;
+
+    if ( head->i )
+        return METRIC(q, head->i->val) < r_sq;
+    if ( !head->c )     /* vacated by refit */
+        return 0;
+
+    for ( i = 0; i < NOC; ++i ) {
+        if ( !(n = head->c[i]) )
+            continue;
+        len = cell(n, &o);
+        if ( mind(q, &o, len) >= r_sq )
+            continue;
+        if ( maxd(q, &o, len) < r_sq )
+            num += n->n;
+        else
+            num += crad( n, q, r_sq );
+    }
+
+    return num;
+}
+
+
+/* count_radius
+ * number of items found by find_radius, without collecting them: cells which
+ * lie completely inside the radius contribute their item count n, so that
+ * their leaves are not visited at all. Requires the counts to be up to date,
+ * see count_items.
+ *
+ * Params
+ * ======
+ * q, Value *          :   query value (need not be in the tree)
+ * r_sq, double        :   squared radius
+ * head, Node *        :   root of quadtree to search in
+ *
+ */
+size_t count_radius( const Value *q, double r_sq, const Node *head )
+{
+    Value o;
+    unsigned int len = cell(head, &o);
+
+    if ( mind(q, &o, len) >= r_sq )
+        return 0;
+    return crad( head, q, r_sq );
+}
+
+
+/* crng - recursive part of count_range, see rng */
+static size_t crng( const Node *head, const Value *o, unsigned int len,
+                    const Value *lo, const Value *hi )
+{
+    uint8_t i;
+    unsigned int lc;
+    size_t num = 0;
+    Value oc;
+
+    if ( head->i )
+        return head->i->val->x >= lo->x && head->i->val->x <= hi->x
+            && head->i->val->y >= lo->y && head->i->val->y <= hi->y;
+    if ( !head->c )     /* vacated by refit */
+        return 0;
+
+    for ( i = 0; i < NOC; ++i ) {
+        if ( !head->c[i] )
+            continue;
+        lc = child_cell(o, len, i, &oc);
+        if ( oc.x > hi->x || oc.x + lc - 1 < lo->x
+                || oc.y > hi->y || oc.y + lc - 1 < lo->y )
+            continue;
+        if ( oc.x >= lo->x && oc.x + lc - 1 <= hi->x
+                && oc.y >= lo->y && oc.y + lc - 1 <= hi->y )
+            num += head->c[i]->n;
+        else
+            num += crng( head->c[i], &oc, lc, lo, hi );
+    }
+
+    return num;
+}
+
+
+/* count_range
+ * number of items found by range_query, without collecting them; see
+ * count_radius
+ *
+ * Params
+ * ======
+ * head, Node *            :   root of quadtree to search in
+ * xmin, ymin, lvl_t       :   lower corner of box
+ * xmax, ymax, lvl_t       :   upper corner of box
+ *
+ */
+size_t count_range( const Node *head, lvl_t xmin, lvl_t ymin, lvl_t xmax,
+                    lvl_t ymax )
+{
+    Value o, lo = { xmin, ymin }, hi = { xmax, ymax };
+    unsigned int len = cell(head, &o);
+
+    if ( xmin > xmax || ymin > ymax )
+        return 0;
+    if ( o.x > hi.x || o.x + len - 1 < lo.x
+            || o.y > hi.y || o.y + len - 1 < lo.y )
+        return 0;
+    return crng( head, &o, len, &lo, &hi );
+}
+
+/* binary heaps on arrays of Entry
+ * up, down: restore heap property after pushing to the end or replacing the
+ * top; sign = 1 gives a min-heap, sign = -1 a max-heap */
+static inline void heap_up( Entry *h, size_t i, int sign )
+{
+    Entry tmp = h[i];
+    while ( i && sign * (tmp.d - h[(i-1)/2].d) < 0 ) {
+        h[i] = h[(i-1)/2];
+        i = (i-1) / 2;
+    }
+    h[i] = tmp;
+}
+
+static inline void heap_down( Entry *h, size_t n, int sign )
+{
+    size_t i = 0, j;
+    Entry tmp = h[0];
+    while ( (j = 2*i + 1) < n ) {
+        if ( j+1 < n && sign * (h[j+1].d - h[j].d) < 0 )
+            ++j;
+        if ( sign * (h[j].d - tmp.d) >= 0 )
+            break;
+        h[i] = h[j];
+        i = j;
+    }
+    h[i] = tmp;
+}
+
+
+static inline void ws_init( knn_ws_t *ws, size_t k )
+{
+    ws->qsize   = 64;
+    ws->q       = xmalloc(sizeof(Entry) * ws->qsize);
+    ws->k       = k;
+    ws->r       = xmalloc(sizeof(Entry) * (k ? k : 1));
+    ws->scale   = 1;
+    ws->max_leaves  = 0;
+}
+
+static inline void ws_free( knn_ws_t *ws )
+{
+    free(ws->q);
+    free(ws->r);
+}
+
+/* push node with distance d onto queue */
+static inline void ws_push( knn_ws_t *ws, const Node *n, double d )
+{
+    if ( ws->qn == ws->qsize ) {
+        ws->qsize *= 2;
+        ws->q = xrealloc(ws->q, sizeof(Entry) * ws->qsize);
+    }
+    ws->q[ws->qn].d     = d;
+    ws->q[ws->qn].p.n   = n;
+    heap_up( ws->q, ws->qn++, 1 );
+}
+
+/* offer item with distance d to the k best ones */
+static inline void ws_offer( knn_ws_t *ws, const Item *i, double d )
+{
+    if ( ws->rn < ws->k ) {
+        ws->r[ws->rn].d     = d;
+        ws->r[ws->rn].p.i   = i;
+        heap_up( ws->r, ws->rn++, -1 );
+    } else if ( d < ws->r[0].d ) {
+        ws->r[0].d      = d;
+        ws->r[0].p.i    = i;
+        heap_down( ws->r, ws->rn, -1 );
+    }
+}
+
+/* distance, an item must beat to be of interest */
+static inline double ws_bound( const knn_ws_t *ws )
+{
+    return ( ws->rn < ws->k ) ? INFINITY : ws->r[0].d;
+}
+
+/* distance, a cell must beat to be visited */
+static inline double ws_prune( const knn_ws_t *ws )
+{
+    return ( ws->rn < ws->k ) ? INFINITY : ws->scale * ws->r[0].d;
+}
+
+
+/* knn_core
+ * best-first traversal: nodes are visited in the order of their minimal
+ * distance to q; the search stops, when the closest remaining cell is farther
+ * away than the k-th best item found so far (divided by 1+eps, see
+ * knn_approx), or when ws->max_leaves leaves have been visited
+ *
+ * Params
+ * ======
+ * head, Node *        :   root of quadtree
+ * q, Value *          :   query value
+ * skip, Item *        :   item to ignore (the query itself) or NULL
+ * ws, knn_ws_t *      :   workspace, initialised with ws_init
+ * out_idx, size_t *   :   original indices (Item.idx) of the found items,
+ *                         ordered by distance; unused entries are set to
+ *                         (size_t)-1
+ * out_dist, double *  :   their squared distances (INFINITY if unused)
+ *
+ * Returns
+ * =======
+ * number of found items, i.e. min(k, number of items in tree)
+ *
+ */
+static size_t knn_core( const Node *head, const Value *q, const Item *skip,
+                        knn_ws_t *ws, size_t *out_idx, double *out_dist )
+{
+    uint8_t j;
+    size_t num, m, leaves = 0;
+    double d;
+    unsigned int len;
+    Value o;
+    const Node *n;
+
+    ws->qn = ws->rn = 0;
+    ws->lower = INFINITY;
+    if ( !ws->k )
+        return 0;
+    len = cell(head, &o);
+    ws_push( ws, head, mind(q, &o, len) );
+
+    while ( ws->qn ) {
+        if ( leaves == ws->max_leaves && ws->max_leaves ) {
+            ws->lower = fmin( ws->lower, ws->q[0].d );
+            break;
+        }
+
+        /* pop closest node */
+        d = ws->q[0].d;
+        n = ws->q[0].p.n;
+        ws->q[0] = ws->q[--ws->qn];
+        heap_down( ws->q, ws->qn, 1 );
+
+        if ( d >= ws_prune(ws) ) {
+            ws->lower = fmin( ws->lower, d );
+            break;
+        }
+
+        if ( n->i ) {
+            ++leaves;
+            if ( n->i != skip )
+                ws_offer( ws, n->i, METRIC(q, n->i->val) );
+        } else if ( n->c ) {
+            for ( j = 0; j < NOC; ++j ) {
+                if ( !n->c[j] )
+                    continue;
+                len = cell(n->c[j], &o);
+                if ( (d = mind(q, &o, len)) < ws_prune(ws) )
+                    ws_push( ws, n->c[j], d );
+                else
+                    ws->lower = fmin( ws->lower, d );
+            }
+        }
+    }
+
+    /* sort ascending by popping the max-heap from the back */
+    num = ws->rn;
+    for ( m = num; m < ws->k; ++m ) {
+        out_idx[m]  = (size_t)-1;
+        out_dist[m] = INFINITY;
+    }
+    while ( ws->rn ) {
+        out_idx[ws->rn-1]   = ws->r[0].p.i->idx;
+        out_dist[ws->rn-1]  = ws->r[0].d;
+        ws->r[0] = ws->r[--ws->rn];
+        heap_down( ws->r, ws->rn, -1 );
+    }
+
+    return num;
+}
+
+
+/* knn
+ * find the k nearest neighbours of a given value
+ *
+ * Params
+ * ======
+ * head, Node *        :   root of quadtree to search in
+ * q, Value *          :   query value (need not be in the tree); if it is,
+ *                         its item is part of the result
+ * k, size_t           :   number of neighbours
+ * out_idx, size_t *   :   array of size k; original indices (Item.idx) of the
+ *                         neighbours, nearest first; (size_t)-1 if the tree
+ *                         holds less than k items
+ * out_dist, double *  :   array of size k; squared distances (INFINITY if
+ *                         unused)
+ *
+ * Returns
+ * =======
+ * number of found neighbours
+ *
+ */
+size_t knn( const Node *head, const Value *q, size_t k,
+            size_t *out_idx, double *out_dist )
+{
+    size_t num;
+    knn_ws_t ws;
+
+    ws_init( &ws, k );
+    num = knn_core( head, q, NULL, &ws, out_idx, out_dist );
+    ws_free( &ws );
+
+    return num;
+}
+
+
+/* knn_all
+ * find the k nearest neighbours for every item, the item itself is excluded
+ *
+ * Params
+ * ======
+ * head, Node *        :   root of quadtree to search in
+ * items, Item *       :   items of the tree, as returned by build_morton
+ * size, size_t        :   number of items
+ * k, size_t           :   number of neighbours
+ * out_idx, size_t *   :   array of size k*size; row i (i.e. out_idx[i*k] to
+ *                         out_idx[i*k+k-1]) holds the neighbours of items[i],
+ *                         so rows are in Morton order; see knn
+ * out_dist, double *  :   array of size k*size; corresponding squared
+ *                         distances
+ *
+ */
+void knn_all( const Node *head, const Item *items, size_t size, size_t k,
+              size_t *out_idx, double *out_dist )
+{
+    size_t i;
+    knn_ws_t ws;
+
+    ws_init( &ws, k );
+    for ( i = 0; i < size; ++i )
+        knn_core( head, items[i].val, &items[i], &ws,
+                  out_idx + i*k, out_dist + i*k );
+    ws_free( &ws );
+}
+
+
+/* knn_approx
+ * find approximate k nearest neighbours of a given value: cells are pruned,
+ * once their distance exceeds the k-th best distance so far divided by 1+eps,
+ * and the search may be cut off after a given number of leaves; without cut
+ * off, the j-th found neighbour is at most (1+eps) times farther away than
+ * the exact j-th nearest neighbour
+ *
+ * Params
+ * ======
+ * head, q, k          :   see knn
+ * eps, double         :   allowed relative error of the distances (>= 0);
+ *                         eps = 0 and max_leaves = 0 give the exact result
+ * max_leaves, size_t  :   maximal number of visited leaves (0: no limit)
+ * out_idx, out_dist   :   see knn
+ * out_eps, double *   :   if not NULL, the achieved error bound is written
+ *                         into it: every found distance is at most (1+out_eps)
+ *                         times the exact one (INFINITY if unbounded, i.e. if
+ *                         the search was cut off before k items were found)
+ *
+ * Returns
+ * =======
+ * number of found neighbours
+ *
+ */
+size_t knn_approx( const Node *head, const Value *q, size_t k, double eps,
+                   size_t max_leaves, size_t *out_idx, double *out_dist,
+                   double *out_eps )
+{
+    size_t num;
+    double worst;
+    knn_ws_t ws;
+
+    ws_init( &ws, k );
+    ws.scale        = 1 / SQUARE(1 + eps);
+    ws.max_leaves   = max_leaves;
+    num = knn_core( head, q, NULL, &ws, out_idx, out_dist );
+    ws_free( &ws );
+
+    /* no item closer than lower was left out, so the j-th found distance is
+     * at most sqrt(worst / lower) times the j-th exact one */
+    if ( out_eps ) {
+        worst = num ? out_dist[num-1] : 0;
+        if ( num < k && ws.lower < INFINITY )
+            *out_eps = INFINITY;
+        else if ( worst <= ws.lower )
+            *out_eps = 0;
+        else
+            *out_eps = ws.lower > 0 ? sqrt(worst / ws.lower) - 1 : INFINITY;
+    }
+
+    return num;
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
@@ -15,17 +15,16 @@ void print_num( const Value *val, int n )
 #if DO_PRINT
 #define PRINT_NUM(v, n) print_num(v, n);
 #define PRINT_INFO(s) printf("\n\n"#s"\nquery\tfound\n");
+#define PRINT_HITS(p) printf("path reused: %zu of %zu\n", p.hits, p.lookups);
 #else
 #define PRINT_NUM(v, n) n;
 #define PRINT_INFO(s)
+#define PRINT_HITS(p)
 #endif
 
 
-#define SD(v, w, a) SQUARE((v)->a - (w)->a)         /* squared difference */
-#define METRIC(v, w) (SD(v, w, x) + SD(v, w, y))
-
-#define SEARCH_FUNC(TYPE, CHECK_QUERY, VALUE_ACCESS)                        \
-static int search_##TYPE( Value *query, DArray_##TYPE *vals, double r_sq,   \
+#define SEARCH_FUNC(NAME, TYPE, CHECK_QUERY, VALUE_ACCESS, DIST)            \
+static int search_##NAME( Value *query, DArray_##TYPE *vals, double r_sq,   \
                    DArray_##TYPE *res )                                     \
 {                                                                           \
     int num;                                                                \
@@ -34,7 +33,7 @@ static int search_##TYPE( Value *query, DArray_##TYPE *vals, double r_sq,   \
     end = DArray_##TYPE##_end(vals);                                        \
     for ( num = 0; it != end; ++it ) {                                      \
         CHECK_QUERY                                                         \
-        if ( METRIC(query, (*it)VALUE_ACCESS) < r_sq ) {                    \
+        if ( DIST(query, (*it)VALUE_ACCESS) < r_sq ) {                      \
             DArray_##TYPE##_append(res, *it);                               \
             ++num;                                                          \
         }                                                                   \
@@ -45,11 +44,12 @@ static int search_##TYPE( Value *query, DArray_##TYPE *vals, double r_sq,   \
 #define EMPTY
 #define CHECK_QUERY if (*it==query) continue;
 #define VALUE_ACCESS ->val
-SEARCH_FUNC(Value, CHECK_QUERY, EMPTY)
-SEARCH_FUNC(Item, EMPTY, VALUE_ACCESS)
+SEARCH_FUNC(Value, Value, CHECK_QUERY, EMPTY, METRIC)
+SEARCH_FUNC(Item, Item, EMPTY, VALUE_ACCESS, METRIC)
+SEARCH_FUNC(Item_periodic, Item, EMPTY, VALUE_ACCESS, METRIC_PERIODIC)
 
 
-#define SEARCH_SETUP(NAME, TYPE, DECL, INIT, PREP, PARAM, FREE)             \
+#define SEARCH_SETUP(NAME, TYPE, DECL, INIT, PREP, PARAM, QUERY, FREE)      \
 int search_##NAME( const fargs_t *fargs )                                   \
 {                                                                           \
     const unsigned int *in = fargs->data;                                   \
@@ -70,7 +70,7 @@ int search_##NAME( const fargs_t *fargs )                                   \
     for ( i = 0; i < size; ++i ) {                                          \
         res._used = 0;                                                      \
         PREP                                                                \
-        PRINT_NUM(PARAMS, search_##TYPE(PARAM, &tmp, r_sq, &res))           \
+        PRINT_NUM(PARAM, QUERY)                                             \
     }                                                                       \
     FREE                                                                    \
     DArray_##TYPE##_free(&res);                                             \
@@ -89,15 +89,203 @@ int search_##NAME( const fargs_t *fargs )                                   \
     DArray_Item_init(&tmp, 8);
 #define FAST_PREP find_neighbours( items[i].key, head, &tmp );
 #define FAST_PARAM (Value *)items[i].val
+#define FAST_QUERY search_Item(FAST_PARAM, &tmp, r_sq, &res)
 #define FAST_FREE           \
     DArray_Item_free(&tmp); \
     cleanup(head);          \
     free(items);
 
 SEARCH_SETUP(fast, Item, FAST_DECL, FAST_INIT(insert_simple), FAST_PREP,
-        FAST_PARAM, FAST_FREE)
+        FAST_PARAM, FAST_QUERY, FAST_FREE)
 SEARCH_SETUP(fastfast, Item, FAST_DECL, FAST_INIT(insert_fast), FAST_PREP,
-        FAST_PARAM, FAST_FREE)
+        FAST_PARAM, FAST_QUERY, FAST_FREE)
+
+/* only the candidates of find_neighbours, i.e. without the distance check */
+#define NEIGHBOURS_QUERY ((void) r_sq, res._used = tmp._used, (int)res._used)
+SEARCH_SETUP(neighbours, Item, FAST_DECL, FAST_INIT(insert_fast), FAST_PREP,
+        FAST_PARAM, NEIGHBOURS_QUERY, FAST_FREE)
+
+
+/* like fastfast, but searches reuse the path of the previous query */
+#define PATH_DECL   \
+    FAST_DECL       \
+    path_t path;
+#define PATH_INIT                   \
+    FAST_INIT(insert_fast)          \
+    path_init(&path, head);
+#define PATH_PREP find_neighbours_path( items[i].key, &path, &tmp );
+#define PATH_FREE                   \
+    PRINT_HITS(path)                \
+    FAST_FREE
+
+SEARCH_SETUP(fastpath, Item, PATH_DECL, PATH_INIT, PATH_PREP, FAST_PARAM,
+        FAST_QUERY, PATH_FREE)
+
+
+/* like fastfast, but searches start at the leaf of the query */
+#define LEAF_DECL   \
+    FAST_DECL       \
+    Node **leaves;
+#define LEAF_INIT                               \
+    FAST_INIT(insert_fast)                      \
+    leaves = index_leaves(head, items, size);
+#define LEAF_PREP find_neighbours_leaf( leaves[i], head, &tmp );
+#define LEAF_FREE       \
+    free(leaves);       \
+    FAST_FREE
+
+SEARCH_SETUP(fastleaf, Item, LEAF_DECL, LEAF_INIT, LEAF_PREP, FAST_PARAM,
+        FAST_QUERY, LEAF_FREE)
+
+
+/* like fastleaf, but the candidates are filtered by vectorised distances */
+#define SIMD_DECL   \
+    LEAF_DECL       \
+    filter_ws_t ws;
+#define SIMD_INIT           \
+    LEAF_INIT               \
+    filter_init(&ws);
+#define SIMD_QUERY filter_radius(FAST_PARAM, &tmp, r_sq, &ws, &res)
+#define SIMD_FREE           \
+    filter_free(&ws);       \
+    LEAF_FREE
+
+SEARCH_SETUP(fastsimd, Item, SIMD_DECL, SIMD_INIT, LEAF_PREP, FAST_PARAM,
+        SIMD_QUERY, SIMD_FREE)
+
+
+/* periodic domain, with minimum image distances */
+#define PERIODIC_PREP find_neighbours_periodic( items[i].key, head, &tmp );
+#define PERIODIC_QUERY search_Item_periodic(FAST_PARAM, &tmp, r_sq, &res)
+
+SEARCH_SETUP(periodic, Item, FAST_DECL, FAST_INIT(insert_fast), PERIODIC_PREP,
+        FAST_PARAM, PERIODIC_QUERY, FAST_FREE)
+
+
+/* complete candidates for any radius, see find_neighbours_ring */
+#define RING_PREP find_neighbours_ring( items[i].key, head, r_sq, 1, &tmp );
+
+SEARCH_SETUP(ring, Item, FAST_DECL, FAST_INIT(insert_fast), RING_PREP,
+        FAST_PARAM, FAST_QUERY, FAST_FREE)
+
+
+/* exact radius search in the tree, no filtering requiered afterwards;
+ * the query itself is part of the result */
+#define RADIUS_QUERY \
+    (find_radius(items[i].val, r_sq, head, &res), (int)res._used)
+
+SEARCH_SETUP(radius, Item, FAST_DECL, FAST_INIT(insert_fast), EMPTY,
+        FAST_PARAM, RADIUS_QUERY, FAST_FREE)
+
+
+/* like radius, but only counts the results (including the query itself) */
+#define COUNT_DECL  \
+    FAST_DECL       \
+    size_t num;
+#define COUNT_QUERY (num = count_radius(items[i].val, r_sq, head), (int)num)
+
+SEARCH_SETUP(count, Item, COUNT_DECL, FAST_INIT(insert_fast), EMPTY,
+        FAST_PARAM, COUNT_QUERY, FAST_FREE)
+
+
+/* like fastfast, but candidates are filtered while searching: neighbours
+ * (without the query itself) are counted by a visitor in a single pass */
+typedef struct vctx_s {
+    const Item *q;
+    size_t num;
+} vctx_t;
+
+RADIUS_VISITOR(count_others, vctx_t *, (ctx->num += item != ctx->q, 0))
+
+#define VISIT_DECL  \
+    FAST_DECL       \
+    vctx_t vctx;
+#define VISIT_QUERY                                                 \
+    (vctx.q = &items[i], vctx.num = 0,                              \
+     count_others(items[i].val, r_sq, head, &vctx), (int)vctx.num)
+
+SEARCH_SETUP(visit, Item, VISIT_DECL, FAST_INIT(insert_fast), EMPTY,
+        FAST_PARAM, VISIT_QUERY, FAST_FREE)
+
+
+/* all-pairs searches, which write the neighbours of all items into a CSR */
+#define PAIRS_SETUP(NAME, CALL)                                             \
+int search_##NAME( const fargs_t *fargs )                                   \
+{                                                                           \
+    const unsigned int *in = fargs->data;                                   \
+    size_t size = fargs->size;                                              \
+    double r_sq = fargs->r_sq;                                              \
+    size_t i, j;                                                            \
+    Value *vals;                                                            \
+    Item *items;                                                            \
+    Node *head;                                                             \
+    CSR csr;                                                                \
+    vals = xmalloc(sizeof(Value) * size);                                   \
+    for ( i = 0, j = 0; i < 2*size; i+=2, j++ ) {                           \
+        vals[j].x = in[i];                                                  \
+        vals[j].y = in[i+1];                                                \
+    }                                                                       \
+    items = xmalloc(sizeof(Item)*size);                                     \
+    items = build_morton(vals, items, size);                                \
+    head = build_tree(items, insert_fast);                                  \
+    CALL;                                                                   \
+    csr_free(&csr);                                                         \
+    cleanup(head);                                                          \
+    free(items);                                                            \
+    free(vals);                                                             \
+    return 0;                                                               \
+}
+
+PAIRS_SETUP(pairs, pairs_radius(head, items, size, r_sq, 0, &csr))
+PAIRS_SETUP(dualtree, pairs_dualtree(head, size, r_sq, 0, &csr))
+/* each unordered pair only once */
+PAIRS_SETUP(pairs_half, pairs_radius(head, items, size, r_sq, 1, &csr))
+PAIRS_SETUP(dualtree_half, pairs_dualtree(head, size, r_sq, 1, &csr))
+/* one thread per processor */
+PAIRS_SETUP(pairs_concurrent,
+        pairs_radius_concurrent(head, items, size, r_sq, 0, 0, &csr))
+
+
+/* accelerations of unit masses by gravity (r_sq is ignored); DECL declares
+ * the solver's state, if any */
+#define GRAVITY_SETUP(NAME, DECL, CALL)                                     \
+int search_##NAME( const fargs_t *fargs )                                   \
+{                                                                           \
+    const unsigned int *in = fargs->data;                                   \
+    size_t size = fargs->size;                                              \
+    size_t i, j;                                                            \
+    Value *vals;                                                            \
+    Item *items;                                                            \
+    Node *head;                                                             \
+    double *ax, *ay;                                                        \
+    DECL                                                                    \
+    vals = xmalloc(sizeof(Value) * size);                                   \
+    for ( i = 0, j = 0; i < 2*size; i+=2, j++ ) {                           \
+        vals[j].x = in[i];                                                  \
+        vals[j].y = in[i+1];                                                \
+    }                                                                       \
+    items = xmalloc(sizeof(Item)*size);                                     \
+    items = build_morton(vals, items, size);                                \
+    head = build_tree(items, insert_fast);                                  \
+    ax = xmalloc(sizeof(double) * size);                                    \
+    ay = xmalloc(sizeof(double) * size);                                    \
+    CALL;                                                                   \
+    free(ax);                                                               \
+    free(ay);                                                               \
+    cleanup(head);                                                          \
+    free(items);                                                            \
+    free(vals);                                                             \
+    return 0;                                                               \
+}
+
+/* softened 1/r^2 gravity, direct is the reference of bh */
+GRAVITY_SETUP(direct, EMPTY, direct_accel(vals, NULL, size, 1.0, ax, ay))
+GRAVITY_SETUP(bh, bh_t bh;, (bh_init(&bh, head, NULL),
+            bh_accel(&bh, items, size, 0.5, 1.0, 1, ax, ay), bh_free(&bh)))
+/* logarithmic potential, direct_log is the reference of fmm */
+GRAVITY_SETUP(direct_log, EMPTY, direct_accel_log(vals, NULL, size, ax, ay))
+GRAVITY_SETUP(fmm, fmm_t fmm;, (fmm_init(&fmm, head, NULL, 8, 0),
+            fmm_accel(&fmm, 1, ax, ay), fmm_free(&fmm)))
 
 
 #define SIMPLE_INIT                 \
@@ -106,8 +294,10 @@ SEARCH_SETUP(fastfast, Item, FAST_DECL, FAST_INIT(insert_fast), FAST_PREP,
         tmp.p[i] = &vals[i];        \
     tmp._used = size;
 #define SIMPLE_PARAM &vals[i]
+#define SIMPLE_QUERY search_Value(SIMPLE_PARAM, &tmp, r_sq, &res)
 #define SIMPLE_FREE DArray_Value_free(&tmp);
 
-SEARCH_SETUP(naive, Value, EMPTY, SIMPLE_INIT, EMPTY, SIMPLE_PARAM, SIMPLE_FREE)
+SEARCH_SETUP(naive, Value, EMPTY, SIMPLE_INIT, EMPTY, SIMPLE_PARAM,
+        SIMPLE_QUERY, SIMPLE_FREE)
 
 /* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
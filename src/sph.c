@@ -0,0 +1,218 @@
+/* This file contains the kernel sums of smoothed-particle hydrodynamics in
+ * 2D: the density
+ *     rho_i = sum_j m_j W(r_ij, h_i)
+ * and the acceleration by the pressure gradient
+ *     a_i = - sum_j m_j (P_i / rho_i^2 + P_j / rho_j^2) grad_i W(r_ij, h_ij)
+ * with h_ij = (h_i + h_j) / 2, so that the forces of a pair are antisymmetric
+ * and momentum is conserved. Neighbours are visited by radius searches in the
+ * tree (see RADIUS_VISITOR), the particles are processed in parallel in
+ * Morton order.
+ */
+#include <math.h>
+#include "sph.h"
+#include "visit.h"
+#include "parallel.h"
+
+
+#define PI 3.14159265358979323846
+
+
+/* sph_w
+ * kernel W(r, h) in 2D, normalised to 1; 0 for r >= 2h
+ *
+ */
+double sph_w( sph_kernel_t kernel, double r, double h )
+{
+    double q = r / h, t = 1 - q / 2;
+
+    if ( q >= 2 )
+        return 0;
+    if ( kernel == SPH_WENDLAND )
+        return 7 / (4 * PI * h * h) * SQUARE(t * t) * (1 + 2 * q);
+    if ( q < 1 )
+        return 10 / (7 * PI * h * h) * (1 - 1.5 * q * q + 0.75 * q * q * q);
+    return 10 / (7 * PI * h * h) * 2 * t * t * t;
+}
+
+
+/* sph_dw
+ * radial derivative dW/dr of the kernel, see sph_w
+ *
+ */
+double sph_dw( sph_kernel_t kernel, double r, double h )
+{
+    double q = r / h, t = 1 - q / 2;
+
+    if ( q >= 2 )
+        return 0;
+    if ( kernel == SPH_WENDLAND )
+        return -35 / (4 * PI * h * h * h) * q * t * t * t;
+    if ( q < 1 )
+        return 10 / (7 * PI * h * h * h) * (-3 * q + 2.25 * q * q);
+    return 10 / (7 * PI * h * h * h) * -0.75 * SQUARE(2 - q);
+}
+
+
+/* sph_init
+ * set up the particles of the items of a tree
+ *
+ * Params
+ * ======
+ * s, sph_t *              :   to initialise
+ * head, Node *            :   root of tree built from items
+ * items, Item *           :   items, as returned by build_morton
+ * size, size_t            :   number of items
+ * kernel, sph_kernel_t    :   smoothing kernel
+ * mass, double *          :   mass of each particle, in Morton order
+ * h, double *             :   smoothing length of each particle (> 0), in
+ *                             Morton order
+ *
+ * All arrays are referenced, not copied.
+ *
+ */
+void sph_init( sph_t *s, const Node *head, const Item *items, size_t size,
+               sph_kernel_t kernel, const double *mass, const double *h )
+{
+    size_t i;
+
+    s->head     = head;
+    s->items    = items;
+    s->size     = size;
+    s->kernel   = kernel;
+    s->mass     = mass;
+    s->h        = h;
+    for ( i = 0, s->hmax = 0; i < size; ++i )
+        if ( h[i] > s->hmax )
+            s->hmax = h[i];
+}
+
+
+/* state of the kernel sum of one particle */
+typedef struct kctx_s {
+    const sph_t *s;
+    const double *rho, *p;
+    size_t i;           /* Morton index of the particle */
+    double sum[2];
+} kctx_t;
+
+
+/* density - add contribution of item to the density of particle ctx->i */
+static inline int density( const Item *item, kctx_t *ctx )
+{
+    const sph_t *s  = ctx->s;
+    size_t j        = item - s->items;
+    double r        = sqrt(METRIC(s->items[ctx->i].val, item->val));
+
+    ctx->sum[0] += s->mass[j] * sph_w(s->kernel, r, s->h[ctx->i]);
+    return 0;
+}
+
+/* pressure - add acceleration by item to particle ctx->i */
+static inline int pressure( const Item *item, kctx_t *ctx )
+{
+    const sph_t *s  = ctx->s;
+    size_t i = ctx->i, j = item - s->items;
+    const Value *vi = s->items[i].val;
+    double dx, dy, r, f;
+
+    if ( j == i )
+        return 0;
+    dx  = (double)vi->x - item->val->x;
+    dy  = (double)vi->y - item->val->y;
+    r   = sqrt(dx*dx + dy*dy);
+    f   = s->mass[j] * (ctx->p[i] / SQUARE(ctx->rho[i])
+                        + ctx->p[j] / SQUARE(ctx->rho[j]))
+        * sph_dw(s->kernel, r, (s->h[i] + s->h[j]) / 2) / r;
+    ctx->sum[0] -= f * dx;
+    ctx->sum[1] -= f * dy;
+    return 0;
+}
+
+RADIUS_VISITOR(density_sum, kctx_t *, density(item, ctx))
+RADIUS_VISITOR(pressure_sum, kctx_t *, pressure(item, ctx))
+
+
+/* arguments of the parallel kernel sums */
+typedef struct sargs_s {
+    const sph_t *s;
+    const double *rho, *p;
+    double *out[2];
+} sargs_t;
+
+
+/* density_task - densities of particles in [b, e) */
+static void density_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    sargs_t *sa = (sargs_t *)ctx;
+    kctx_t kc   = { sa->s, NULL, NULL, 0, { 0, 0 } };
+    (void) tid;
+
+    for ( ; b < e; ++b ) {
+        kc.i        = b;
+        kc.sum[0]   = 0;
+        density_sum( sa->s->items[b].val, SQUARE(2 * sa->s->h[b]),
+                     sa->s->head, &kc );
+        sa->out[0][b] = kc.sum[0];
+    }
+}
+
+
+/* accel_task - accelerations of particles in [b, e); h_ij is at most
+ * (h_i + hmax) / 2, which bounds the search radius */
+static void accel_task( size_t b, size_t e, unsigned int tid, void *ctx )
+{
+    sargs_t *sa = (sargs_t *)ctx;
+    kctx_t kc   = { sa->s, sa->rho, sa->p, 0, { 0, 0 } };
+    (void) tid;
+
+    for ( ; b < e; ++b ) {
+        kc.i        = b;
+        kc.sum[0]   = kc.sum[1] = 0;
+        pressure_sum( sa->s->items[b].val,
+                      SQUARE(sa->s->h[b] + sa->s->hmax), sa->s->head, &kc );
+        sa->out[0][b] = kc.sum[0];
+        sa->out[1][b] = kc.sum[1];
+    }
+}
+
+
+/* sph_density
+ * compute the density of every particle (including itself)
+ *
+ * Params
+ * ======
+ * s, sph_t *              :   particles
+ * nthreads, unsigned int  :   number of threads (0: one per processor)
+ * rho, double *           :   density of each particle, in Morton order
+ *
+ */
+void sph_density( const sph_t *s, unsigned int nthreads, double *rho )
+{
+    sargs_t sa = { s, NULL, NULL, { rho, NULL } };
+
+    parallel_for( s->size, 0, nthreads, density_task, &sa );
+}
+
+
+/* sph_accel
+ * compute the acceleration of every particle by the pressure gradient
+ *
+ * Params
+ * ======
+ * s, sph_t *              :   particles
+ * rho, double *           :   densities, see sph_density
+ * p, double *             :   pressures (e.g. from an equation of state of
+ *                             rho), in Morton order
+ * nthreads, unsigned int  :   number of threads (0: one per processor)
+ * ax, ay, double *        :   acceleration of each particle, in Morton order
+ *
+ */
+void sph_accel( const sph_t *s, const double *rho, const double *p,
+                unsigned int nthreads, double *ax, double *ay )
+{
+    sargs_t sa = { s, rho, p, { ax, ay } };
+
+    parallel_for( s->size, 0, nthreads, accel_task, &sa );
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
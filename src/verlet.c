@@ -0,0 +1,132 @@
+/* This file contains Verlet neighbour lists: the all-pairs search is done with
+ * an enlarged radius r + skin, and its result is reused as long as no value
+ * moved farther than skin/2, so that the tree is only rebuilt every few steps
+ * of a simulation.
+ */
+#include "verlet.h"
+#include "morton.h"
+
+
+/* build
+ * build tree from the current values, search all pairs within r + skin and
+ * remember the values
+ *
+ */
+static void build( verlet_t *v )
+{
+    size_t i;
+    Node *head;
+
+    csr_free( &v->list );
+    build_morton( v->vals, v->items, v->size );
+    head = build_tree( v->items, insert_fast );
+    pairs_radius( head, v->items, v->size, v->rs_sq, 0, &v->list );
+    cleanup( head );
+
+    for ( i = 0; i < v->size; ++i )
+        v->ref[i] = v->vals[i];
+    ++v->builds;
+}
+
+
+/* verlet_init
+ * set up list for given values and build it
+ *
+ * Params
+ * ======
+ * v, verlet_t *   :   list to initialise, free with verlet_free
+ * vals, Value *   :   values; they are referenced (not copied), so changes
+ *                     are seen by verlet_update
+ * size, size_t    :   number of values (> 0)
+ * r, double       :   interaction radius
+ * skin, double    :   additional radius of the list (>= 0); larger values
+ *                     mean less rebuilds, but longer lists
+ *
+ */
+void verlet_init( verlet_t *v, const Value *vals, size_t size, double r,
+                  double skin )
+{
+    v->vals         = vals;
+    v->size         = size;
+    v->r_sq         = SQUARE(r);
+    v->rs_sq        = SQUARE(r + skin);
+    v->half_skin_sq = SQUARE(skin / 2);
+    v->list.n       = 0;
+    v->list.offsets = v->list.indices = NULL;
+    v->ref          = xmalloc(sizeof(Value) * size);
+    v->items        = xmalloc(sizeof(Item) * size);
+    v->builds       = 0;
+
+    build( v );
+}
+
+
+/* verlet_update
+ * check the displacements since the last build and rebuild the list, if any
+ * is larger than skin/2; call after each change of the values
+ *
+ * Returns
+ * =======
+ * 1 if the list was rebuilt, 0 otherwise
+ *
+ */
+int verlet_update( verlet_t *v )
+{
+    size_t i;
+
+    for ( i = 0; i < v->size; ++i ) {
+        if ( METRIC(&v->vals[i], &v->ref[i]) > v->half_skin_sq ) {
+            build( v );
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* verlet_pairs
+ * filter the list by the current distances, i.e. write all pairs within r
+ * into out (same layout as the result of pairs_radius); requires, that
+ * verlet_update was called after the values have changed
+ *
+ * Params
+ * ======
+ * v, verlet_t *   :   up to date list
+ * out, CSR *      :   result, free with csr_free
+ *
+ */
+void verlet_pairs( const verlet_t *v, CSR *out )
+{
+    size_t i, j, m = 0;
+    const CSR *l = &v->list;
+
+    out->n          = l->n;
+    out->offsets    = xmalloc(sizeof(size_t) * (l->n + 1));
+    out->indices    = xmalloc(sizeof(size_t) * (l->offsets[l->n] + 1));
+
+    for ( i = 0; i < l->n; ++i ) {
+        out->offsets[i] = m;
+        for ( j = l->offsets[i]; j < l->offsets[i+1]; ++j )
+            if ( METRIC(&v->vals[i], &v->vals[l->indices[j]]) < v->r_sq )
+                out->indices[m++] = l->indices[j];
+    }
+    out->offsets[l->n] = m;
+}
+
+
+/* verlet_free
+ * free buffers of list
+ *
+ */
+void verlet_free( verlet_t *v )
+{
+    csr_free( &v->list );
+    free(v->ref);
+    free(v->items);
+    v->ref      = NULL;
+    v->items    = NULL;
+    v->size     = 0;
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
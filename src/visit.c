@@ -0,0 +1,42 @@
+/* This file contains the generic instance of the radius visitor, which calls
+ * a function pointer per item. Callers with a fixed visit should rather
+ * define their own instance with RADIUS_VISITOR, see visit.h.
+ */
+#include "visit.h"
+
+
+/* visitor and its context */
+typedef struct fp_s {
+    visitor_t visit;
+    void *ctx;
+} fp_t;
+
+RADIUS_VISITOR(radius_fp, const fp_t *, ctx->visit(item, ctx->ctx))
+
+
+/* for_radius
+ * call visit for every item, whose distance to q is less than r (in the same
+ * order as find_radius writes them), until it returns nonzero
+ *
+ * Params
+ * ======
+ * q, Value *          :   query value (need not be in the tree)
+ * r_sq, double        :   squared radius
+ * head, Node *        :   root of quadtree to search in
+ * visit, visitor_t    :   called with each item and ctx
+ * ctx, void *         :   context of visit
+ *
+ * Returns
+ * =======
+ * 1 if visit stopped the search, 0 otherwise
+ *
+ */
+int for_radius( const Value *q, double r_sq, const Node *head,
+                visitor_t visit, void *ctx )
+{
+    fp_t fp = { visit, ctx };
+
+    return radius_fp( q, r_sq, head, &fp );
+}
+
+/* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
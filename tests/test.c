@@ -199,6 +199,1295 @@ test_quadtree_neighbours(const MunitParameter params[], void *data)
 }
 
 
+static MunitResult
+test_quadtree_refit(const MunitParameter params[], void *data)
+{
+    (void) params;
+    (void) data;
+
+    size_t i, j, size = __any_values_1_size;
+    Value vals[size];
+    Item items[size], fresh_items[size];
+    uint8_t found[size];
+    Node *head, *fresh, *tmp;
+    refit_stats_t stats;
+    DArray_Item neighbours, expected;
+
+    for ( i = 0; i < size; ++i )
+        vals[i] = __any_values_1[i];
+    build_morton( vals, items, size );
+    head = build_tree( items, insert_fast );
+
+    /* stays in its cell */
+    vals[4].x = 0x1;
+    /* leave their cells */
+    vals[9].y = 0x8C;
+    vals[11].x = 0x0; vals[11].y = 0x1;
+
+    refit( head, items, &stats );
+    assert_size(stats.moved, ==, 2);
+
+    for ( i = 0; i < size; ++i ) {
+        assert_uint16(items[i].key, ==,
+                      interleave(items[i].val->x, items[i].val->y));
+        tmp = search( items[i].key, head, maxlvl );
+        assert_ptr_equal(tmp->i, &items[i]);
+    }
+
+    /* vacated nodes must not change the neighbour search: compare with a
+     * tree built from scratch (by original index, both are sets) */
+    build_morton( vals, fresh_items, size );
+    fresh = build_tree( fresh_items, insert_fast );
+    DArray_Item_init(&neighbours, 8);
+    DArray_Item_init(&expected, 8);
+    for ( i = 0; i < size; ++i ) {
+        find_neighbours( items[i].key, head, &neighbours );
+        find_neighbours( items[i].key, fresh, &expected );
+        assert_size(neighbours._used, ==, expected._used);
+        for ( j = 0; j < size; ++j )
+            found[j] = 0;
+        for ( j = 0; j < expected._used; ++j )
+            found[expected.p[j]->idx] = 1;
+        for ( j = 0; j < neighbours._used; ++j )
+            assert_uint8(found[neighbours.p[j]->idx]--, ==, 1);
+    }
+    DArray_Item_free(&neighbours);
+    DArray_Item_free(&expected);
+
+    cleanup(fresh);
+    cleanup(head);
+
+    return MUNIT_OK;
+}
+
+
+/* check_parents
+ * recursively check the parent links of head's subtree */
+static void
+check_parents(const Node *head)
+{
+    size_t i;
+
+    if ( !head->c )
+        return;
+    for ( i = 0; i < NOC; ++i ) {
+        if ( !head->c[i] )
+            continue;
+        assert_ptr_equal(head->c[i]->p, head);
+        check_parents( head->c[i] );
+    }
+}
+
+
+/* check_counts
+ * recursively check the item counts of head's subtree, returns its count */
+static size_t
+check_counts(const Node *head)
+{
+    size_t i, num = head->i ? 1 : 0;
+
+    if ( head->c )
+        for ( i = 0; i < NOC; ++i )
+            if ( head->c[i] )
+                num += check_counts( head->c[i] );
+    assert_size(head->n, ==, num);
+
+    return num;
+}
+
+
+static MunitResult
+test_quadtree_concurrent(const MunitParameter params[], void *data)
+{
+    (void) params;
+    (void) data;
+
+    size_t i, size = size_1265;
+    Value *vals = xmalloc( sizeof(Value) * size );
+    Item *items = xmalloc( sizeof(Item) * size );
+    Node *ref, *head, *a, *b;
+
+    for ( i = 0; i < size; ++i ) {
+        vals[i].x = input_data_1265[2*i];
+        vals[i].y = input_data_1265[2*i+1];
+    }
+    build_morton( vals, items, size );
+
+    /* the shape of the tree does not depend on the order of insertion */
+    ref     = build_tree( items, insert_simple );
+    head    = build_tree_concurrent( items, size, 8 );
+
+    for ( i = 0; i < size; ++i ) {
+        a = search( items[i].key, ref, maxlvl );
+        b = search( items[i].key, head, maxlvl );
+        assert_ptr_equal(b->i, &items[i]);
+        assert_null(b->c);
+        assert_uint8(a->lvl, ==, b->lvl);
+        assert_uint16(a->key, ==, b->key);
+    }
+    check_parents( ref );
+    check_parents( head );
+    assert_size(check_counts( ref ), ==, size);
+    assert_size(check_counts( head ), ==, size);
+    cleanup(head);
+
+    /* without items, the root is empty */
+    head    = build_tree_concurrent( items, 0, 8 );
+    assert_uint8(head->lvl, ==, 0);
+    assert_size(check_counts( head ), ==, 0);
+
+    cleanup(ref);
+    cleanup(head);
+    free(items);
+    free(vals);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_quadtree_root(const MunitParameter params[], void *data)
+{
+    (void) params;
+    (void) data;
+
+    size_t i, j, size = size_32;
+    Value vals[size];
+    Item items[size];
+    Node *head, full = { 0, NULL, 0, NULL, 1, NULL, 0 };
+    DArray_Item adaptive, reference;
+    unsigned int len;
+    Value o, q;
+
+    /* clustered data: all values are < 64 */
+    for ( i = 0; i < size; ++i ) {
+        vals[i].x = input_data_32[2*i];
+        vals[i].y = input_data_32[2*i+1];
+    }
+    build_morton( vals, items, size );
+    head = build_tree( items, insert_fast );
+    assert_uint8(head->lvl, >=, 2);
+    check_parents( head );
+    assert_size(check_counts( head ), ==, size);
+
+    /* reference tree with root covering the whole key space */
+    full.c = xmalloc( sizeof(Node *) * NOC );
+    for ( i = 0; i < NOC; ++i )
+        full.c[i] = NULL;
+    for ( i = 0; i < size; ++i )
+        insert_fast( &full, &items[i] );
+
+    DArray_Item_init(&adaptive, 8);
+    DArray_Item_init(&reference, 8);
+    for ( i = 0; i < size; ++i ) {
+        assert_ptr_equal(search( items[i].key, head, maxlvl )->i, &items[i]);
+        find_neighbours( items[i].key, head, &adaptive );
+        find_neighbours( items[i].key, &full, &reference );
+        assert_size(adaptive._used, ==, reference._used);
+        for ( j = 0; j < adaptive._used; ++j )
+            assert_ptr_equal(adaptive.p[j], reference.p[j]);
+    }
+
+    /* values outside of the root's cell are moved onto its boundary */
+    len = cell( head, &o );
+    q.x = 0xC8;
+    q.y = o.y + len / 2;
+    find_neighbours_point( &q, head, &adaptive );
+    q.x = o.x + len - 1;
+    find_neighbours_point( &q, head, &reference );
+    assert_ptr_equal(locate( &q, head ), search( interleave(q.x, q.y), head,
+                                                 maxlvl ));
+    assert_size(adaptive._used, ==, reference._used);
+    for ( j = 0; j < adaptive._used; ++j )
+        assert_ptr_equal(adaptive.p[j], reference.p[j]);
+    DArray_Item_free(&adaptive);
+    DArray_Item_free(&reference);
+
+    /* leaving the root's cell moves the root up */
+    vals[0].x = 0xC8; vals[0].y = 0xC8;
+    refit( head, items, NULL );
+    assert_uint8(head->lvl, ==, 0);
+    for ( i = 0; i < size; ++i )
+        assert_ptr_equal(search( items[i].key, head, maxlvl )->i, &items[i]);
+    assert_null(head->p);
+    check_parents( head );
+    assert_size(check_counts( head ), ==, size);
+
+    full.allocated = 0;
+    cleanup(&full);
+    cleanup(head);
+
+    return MUNIT_OK;
+}
+
+
+/* contains - whether item is part of res */
+static int
+contains(const DArray_Item *res, const Item *item)
+{
+    size_t i;
+
+    for ( i = 0; i < res->_used; ++i )
+        if ( res->p[i] == item )
+            return 1;
+    return 0;
+}
+
+
+static MunitResult
+test_quadtree_periodic(const MunitParameter params[], void *data)
+{
+    (void) params;
+    (void) data;
+
+    size_t i, j, k, size = size_1265;
+    Value *vals = xmalloc( sizeof(Value) * size );
+    Item *items = xmalloc( sizeof(Item) * size );
+    Node *head;
+    DArray_Item open, periodic;
+    /* pairs of values on opposite boundaries */
+    Value edge[6] = {
+        { 0, 100 }, { 255, 100 }, { 100, 0 }, { 100, 255 }, { 0, 0 },
+        { 255, 255 }
+    };
+    Item eitems[6];
+
+    DArray_Item_init(&open, 8);
+    DArray_Item_init(&periodic, 8);
+
+    /* wrapping only adds neighbours, without duplicates */
+    for ( i = 0; i < size; ++i ) {
+        vals[i].x = input_data_1265[2*i];
+        vals[i].y = input_data_1265[2*i+1];
+    }
+    build_morton( vals, items, size );
+    head = build_tree( items, insert_fast );
+    for ( i = 0; i < size; ++i ) {
+        find_neighbours( items[i].key, head, &open );
+        find_neighbours_periodic( items[i].key, head, &periodic );
+        for ( j = 0; j < open._used; ++j )
+            assert_true(contains( &periodic, open.p[j] ));
+        for ( j = 0; j < periodic._used; ++j )
+            for ( k = j + 1; k < periodic._used; ++k )
+                assert_ptr_not_equal(periodic.p[j], periodic.p[k]);
+    }
+    cleanup(head);
+
+    /* neighbours across the boundary */
+    build_morton( edge, eitems, 6 );
+    head = build_tree( eitems, insert_fast );
+    for ( i = 0; i < 6; ++i ) {
+        find_neighbours( eitems[i].key, head, &open );
+        find_neighbours_periodic( eitems[i].key, head, &periodic );
+        for ( j = 0; j < 6; ++j ) {
+            if ( j == i || METRIC_PERIODIC(eitems[i].val, eitems[j].val) > 2 )
+                continue;
+            assert_false(contains( &open, &eitems[j] ));
+            assert_true(contains( &periodic, &eitems[j] ));
+        }
+    }
+    cleanup(head);
+
+    /* two cells per dimension: left and right are the same cell */
+    build_morton( edge, eitems, 2 );
+    head = build_tree( eitems, insert_fast );
+    find_neighbours_periodic( eitems[0].key, head, &periodic );
+    assert_size(periodic._used, ==, 1);
+    assert_ptr_equal(periodic.p[0], &eitems[1]);
+    cleanup(head);
+
+    DArray_Item_free(&open);
+    DArray_Item_free(&periodic);
+    free(items);
+    free(vals);
+
+    return MUNIT_OK;
+}
+
+
+/*********************************************************************/
+
+
+/********************/
+/*      QUERY       */
+/********************/
+
+static void *
+sample_setup(const MunitParameter params[], void *data)
+{
+    (void) params;
+    (void) data;
+
+    size_t i;
+    SampleStruct *sp    = xmalloc( sizeof(SampleStruct) );
+    sp->s               = size_1265;
+    sp->v               = xmalloc( sizeof(Value) * sp->s );
+    sp->i               = xmalloc( sizeof(Item) * sp->s );
+
+    for ( i = 0; i < sp->s; ++i ) {
+        sp->v[i].x = input_data_1265[2*i];
+        sp->v[i].y = input_data_1265[2*i+1];
+    }
+    build_morton( sp->v, sp->i, sp->s );
+    sp->h = build_tree( sp->i, insert_fast );
+
+    return (void *)sp;
+}
+
+static void
+sample_teardown(void *data)
+{
+    SampleStruct *sp = (SampleStruct *)data;
+
+    cleanup(sp->h);
+    free(sp->i);
+    free(sp->v);
+    free(sp);
+}
+
+
+static MunitResult
+test_query_path(const MunitParameter params[], void *data)
+{
+    (void) params;
+
+    size_t i, j;
+    SampleStruct *sp    = (SampleStruct *)data;
+    DArray_Item ref, res;
+    path_t path;
+
+    DArray_Item_init(&ref, 8);
+    DArray_Item_init(&res, 8);
+    path_init( &path, sp->h );
+    for ( i = 0; i < sp->s; ++i ) {
+        find_neighbours( sp->i[i].key, sp->h, &ref );
+        find_neighbours_path( sp->i[i].key, &path, &res );
+        assert_size(res._used, ==, ref._used);
+        for ( j = 0; j < res._used; ++j )
+            assert_ptr_equal(res.p[j], ref.p[j]);
+    }
+    /* most searches in Morton order reuse a part of the previous path */
+    assert_size(path.lookups, >=, sp->s);
+    assert_size(2 * path.hits, >, path.lookups);
+    DArray_Item_free(&ref);
+    DArray_Item_free(&res);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_query_leaf(const MunitParameter params[], void *data)
+{
+    (void) params;
+
+    size_t i, j;
+    SampleStruct *sp    = (SampleStruct *)data;
+    Node **leaves       = index_leaves( sp->h, sp->i, sp->s );
+    DArray_Item ref, res;
+
+    DArray_Item_init(&ref, 8);
+    DArray_Item_init(&res, 8);
+    for ( i = 0; i < sp->s; ++i ) {
+        assert_ptr_equal(leaves[i], search( sp->i[i].key, sp->h, maxlvl ));
+        find_neighbours( sp->i[i].key, sp->h, &ref );
+        find_neighbours_leaf( leaves[i], sp->h, &res );
+        assert_size(res._used, ==, ref._used);
+        for ( j = 0; j < res._used; ++j )
+            assert_ptr_equal(res.p[j], ref.p[j]);
+    }
+    DArray_Item_free(&ref);
+    DArray_Item_free(&res);
+    free(leaves);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_query_point(const MunitParameter params[], void *data)
+{
+    (void) params;
+
+    size_t i, j;
+    SampleStruct *sp    = (SampleStruct *)data;
+    uint8_t *found      = xmalloc( sp->s );
+    DArray_Item ref, res;
+    Value q;
+    Node *c;
+
+    DArray_Item_init(&ref, 8);
+    DArray_Item_init(&res, 8);
+
+    /* values of the tree: its item, followed by find_neighbours */
+    for ( i = 0; i < sp->s; ++i ) {
+        assert_ptr_equal(locate( sp->i[i].val, sp->h )->i, &sp->i[i]);
+        find_neighbours( sp->i[i].key, sp->h, &ref );
+        find_neighbours_point( sp->i[i].val, sp->h, &res );
+        assert_size(res._used, ==, ref._used + 1);
+        assert_ptr_equal(res.p[0], &sp->i[i]);
+        for ( j = 0; j < ref._used; ++j )
+            assert_ptr_equal(res.p[j+1], ref.p[j]);
+    }
+
+    /* grid of probes: every item in the 3x3 pixels around q is found once */
+    for ( i = 0; i < 256 * 256; i += 7 ) {
+        q.x = i & 255;
+        q.y = i >> 8;
+        c = locate( &q, sp->h );
+        /* either a leaf or q's child is missing */
+        assert_true(!c->c || !c->c[(interleave(q.x, q.y)
+                        >> DIM * (maxlvl - c->lvl - 1)) & 3]);
+        find_neighbours_point( &q, sp->h, &res );
+        for ( j = 0; j < sp->s; ++j )
+            found[j] = 0;
+        for ( j = 0; j < res._used; ++j )
+            assert_uint8(found[res.p[j]->idx]++, ==, 0);
+        for ( j = 0; j < sp->s; ++j )
+            if ( abs(sp->v[j].x - q.x) <= 1 && abs(sp->v[j].y - q.y) <= 1 )
+                assert_uint8(found[j], ==, 1);
+    }
+    DArray_Item_free(&ref);
+    DArray_Item_free(&res);
+    free(found);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_query_filter(const MunitParameter params[], void *data)
+{
+    double r_sq         = atof(munit_parameters_get(params, "r_sq"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    size_t i, j, k, num;
+    DArray_Item cand, res;
+    filter_ws_t ws;
+
+    DArray_Item_init(&cand, 8);
+    DArray_Item_init(&res, 8);
+    filter_init( &ws );
+    for ( i = 0; i < sp->s; i += 7 ) {
+        /* varying number of candidates, to cover vector loops and remainder */
+        cand._used = 0;
+        for ( j = i % 61; j < sp->s; j += 1 + i % 5 )
+            DArray_Item_append(&cand, &sp->i[j]);
+        res._used = 0;
+        num = filter_radius( sp->i[i].val, &cand, r_sq, &ws, &res );
+        assert_size(num, ==, res._used);
+        for ( j = 0, k = 0; j < cand._used; ++j )
+            if ( METRIC(sp->i[i].val, cand.p[j]->val) < r_sq )
+                assert_ptr_equal(res.p[k++], cand.p[j]);
+        assert_size(k, ==, num);
+    }
+    filter_free( &ws );
+    DArray_Item_free(&cand);
+    DArray_Item_free(&res);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_query_ring(const MunitParameter params[], void *data)
+{
+    double r_sq         = atof(munit_parameters_get(params, "r_sq"));
+    lvl_t rings         = atoi(munit_parameters_get(params, "rings"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    size_t i, j, num;
+    const Value *q;
+    uint8_t *found      = xmalloc( sp->s );
+    DArray_Item res;
+
+    DArray_Item_init(&res, 8);
+    for ( i = 0; i < sp->s; ++i ) {
+        q = sp->i[i].val;
+        find_neighbours_ring( sp->i[i].key, sp->h, r_sq, rings, &res );
+        for ( j = 0; j < sp->s; ++j )
+            found[j] = 0;
+        /* no duplicates, all within r are found */
+        for ( j = 0, num = 0; j < res._used; ++j ) {
+            assert_uint8(found[res.p[j] - sp->i]++, ==, 0);
+            num += METRIC(q, res.p[j]->val) < r_sq;
+        }
+        for ( j = 0; j < sp->s; ++j )
+            if ( METRIC(q, sp->i[j].val) < r_sq )
+                --num;
+        assert_size(num, ==, 0);
+    }
+    DArray_Item_free(&res);
+    free(found);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_query_range(const MunitParameter params[], void *data)
+{
+    (void) params;
+
+    size_t i, j, k;
+    SampleStruct *sp    = (SampleStruct *)data;
+    const Value *v;
+    DArray_Item res;
+    /* xmin, ymin, xmax, ymax */
+    const lvl_t boxes[][4] = {
+        { 0, 0, 255, 255 }, { 10, 20, 30, 40 }, { 100, 0, 100, 255 },
+        { 64, 64, 127, 127 }, { 63, 63, 128, 128 }, { 200, 5, 255, 90 },
+        { 7, 7, 7, 7 }, { 50, 50, 40, 60 }
+    };
+
+    DArray_Item_init(&res, 8);
+    for ( i = 0; i < sizeof(boxes) / sizeof(boxes[0]); ++i ) {
+        range_query( sp->h, boxes[i][0], boxes[i][1], boxes[i][2],
+                     boxes[i][3], &res );
+        /* compare with brute force, both in Morton order */
+        for ( j = 0, k = 0; j < sp->s; ++j ) {
+            v = sp->i[j].val;
+            if ( v->x >= boxes[i][0] && v->x <= boxes[i][2]
+                    && v->y >= boxes[i][1] && v->y <= boxes[i][3] ) {
+                assert_size(k, <, res._used);
+                assert_ptr_equal(res.p[k++], &sp->i[j]);
+            }
+        }
+        assert_size(k, ==, res._used);
+    }
+    DArray_Item_free(&res);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_query_radius(const MunitParameter params[], void *data)
+{
+    size_t i, j, num;
+    double r_sq         = atof(munit_parameters_get(params, "r_sq"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    uint8_t *found      = xmalloc( sp->s );
+    DArray_Item res;
+
+    DArray_Item_init(&res, 8);
+    for ( i = 0; i < sp->s; ++i ) {
+        find_radius( sp->i[i].val, r_sq, sp->h, &res );
+
+        /* each result is within r and found only once ... */
+        for ( j = 0; j < sp->s; ++j )
+            found[j] = 0;
+        for ( j = 0; j < res._used; ++j ) {
+            assert_double(METRIC(sp->i[i].val, res.p[j]->val), <, r_sq);
+            assert_uint8(found[res.p[j]->idx]++, ==, 0);
+        }
+
+        /* ... and no item within r is missing */
+        for ( num = 0, j = 0; j < sp->s; ++j )
+            if ( METRIC(sp->i[i].val, &sp->v[j]) < r_sq )
+                ++num;
+        assert_size(res._used, ==, num);
+    }
+    DArray_Item_free(&res);
+    free(found);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_query_count(const MunitParameter params[], void *data)
+{
+    size_t i;
+    double r_sq         = atof(munit_parameters_get(params, "r_sq"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    DArray_Item res;
+    Value q;
+
+    DArray_Item_init(&res, 8);
+    for ( i = 0; i < sp->s; ++i ) {
+        find_radius( sp->i[i].val, r_sq, sp->h, &res );
+        assert_size(count_radius( sp->i[i].val, r_sq, sp->h ), ==, res._used);
+    }
+    /* values not in the tree and boxes */
+    for ( i = 0; i < 256; ++i ) {
+        q.x = (i * 37) & 255;
+        q.y = (i * 101 + 13) & 255;
+        find_radius( &q, r_sq, sp->h, &res );
+        assert_size(count_radius( &q, r_sq, sp->h ), ==, res._used);
+        range_query( sp->h, q.x / 2, q.y / 2, q.x, q.y, &res );
+        assert_size(count_range( sp->h, q.x / 2, q.y / 2, q.x, q.y ), ==,
+                    res._used);
+    }
+    DArray_Item_free(&res);
+
+    return MUNIT_OK;
+}
+
+
+/* visitors of test_query_visit */
+RADIUS_VISITOR(collect, DArray_Item *, (DArray_Item_append(ctx, item), 0))
+
+static int
+stop_after(const Item *item, void *ctx)
+{
+    (void) item;
+    return --*(size_t *)ctx == 0;
+}
+
+static MunitResult
+test_query_visit(const MunitParameter params[], void *data)
+{
+    size_t i, j, left;
+    double r_sq         = atof(munit_parameters_get(params, "r_sq"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    DArray_Item ref, res;
+
+    DArray_Item_init(&ref, 8);
+    DArray_Item_init(&res, 8);
+    for ( i = 0; i < sp->s; ++i ) {
+        /* same items in the same order as find_radius */
+        find_radius( sp->i[i].val, r_sq, sp->h, &ref );
+        res._used = 0;
+        assert_int(collect( sp->i[i].val, r_sq, sp->h, &res ), ==, 0);
+        assert_size(res._used, ==, ref._used);
+        for ( j = 0; j < res._used; ++j )
+            assert_ptr_equal(res.p[j], ref.p[j]);
+
+        /* early exit after 3 items */
+        left = 3;
+        assert_int(for_radius( sp->i[i].val, r_sq, sp->h, stop_after, &left ),
+                   ==, ref._used >= 3);
+        assert_size(left, ==, ref._used >= 3 ? 0 : 3 - ref._used);
+    }
+    DArray_Item_free(&ref);
+    DArray_Item_free(&res);
+
+    return MUNIT_OK;
+}
+
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static MunitResult
+test_query_knn(const MunitParameter params[], void *data)
+{
+    size_t i, j, n;
+    size_t k            = atoi(munit_parameters_get(params, "k"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    double *exp         = xmalloc( sizeof(double) * sp->s );
+    size_t *idx         = xmalloc( sizeof(size_t) * sp->s * k );
+    double *dist        = xmalloc( sizeof(double) * sp->s * k );
+    Value probe;
+
+    /* all items, excluding themselves */
+    knn_all( sp->h, sp->i, sp->s, k, idx, dist );
+    for ( i = 0; i < sp->s; ++i ) {
+        for ( n = 0, j = 0; j < sp->s; ++j )
+            if ( j != sp->i[i].idx )
+                exp[n++] = METRIC(sp->i[i].val, &sp->v[j]);
+        qsort( exp, n, sizeof(double), cmp_double );
+        for ( j = 0; j < k; ++j ) {
+            assert_double(dist[i*k+j], ==, exp[j]);
+            assert_double(METRIC(sp->i[i].val, &sp->v[idx[i*k+j]]), ==,
+                          exp[j]);
+        }
+    }
+
+    /* arbitrary values */
+    for ( i = 0; i < 64; ++i ) {
+        probe.x = (i * 37) % 256;
+        probe.y = (i * 91) % 256;
+        assert_size(knn( sp->h, &probe, k, idx, dist ), ==, k);
+        for ( j = 0; j < sp->s; ++j )
+            exp[j] = METRIC(&probe, &sp->v[j]);
+        qsort( exp, sp->s, sizeof(double), cmp_double );
+        for ( j = 0; j < k; ++j )
+            assert_double(dist[j], ==, exp[j]);
+    }
+
+    free(dist);
+    free(idx);
+    free(exp);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_query_ann(const MunitParameter params[], void *data)
+{
+    size_t i, j, num;
+    size_t k            = atoi(munit_parameters_get(params, "k"));
+    double eps          = atof(munit_parameters_get(params, "eps"));
+    size_t leaves       = atoi(munit_parameters_get(params, "leaves"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    double *exp         = xmalloc( sizeof(double) * sp->s );
+    size_t *idx         = xmalloc( sizeof(size_t) * k );
+    double *dist        = xmalloc( sizeof(double) * k );
+    double achieved;
+    Value probe;
+
+    for ( i = 0; i < 256; ++i ) {
+        probe.x = (i * 37) % 256;
+        probe.y = (i * 91) % 256;
+        num = knn_approx( sp->h, &probe, k, eps, leaves, idx, dist,
+                          &achieved );
+        assert_size(num, <=, k);
+        if ( !leaves ) {
+            assert_size(num, ==, k);
+            assert_double(achieved, <=, eps + 1e-9);
+        }
+        for ( j = 0; j < sp->s; ++j )
+            exp[j] = METRIC(&probe, &sp->v[j]);
+        qsort( exp, sp->s, sizeof(double), cmp_double );
+        for ( j = 0; j < num; ++j ) {
+            assert_double(METRIC(&probe, &sp->v[idx[j]]), ==, dist[j]);
+            if ( achieved == 0 )
+                assert_double(dist[j], ==, exp[j]);
+            else if ( !isinf(achieved) )
+                assert_double(dist[j], <=,
+                              SQUARE(1 + achieved) * exp[j] + 1e-9);
+        }
+    }
+
+    free(dist);
+    free(idx);
+    free(exp);
+
+    return MUNIT_OK;
+}
+
+
+/********************/
+/*      PAIRS       */
+/********************/
+
+/* check_csr
+ * compare neighbour lists with brute force search; if half is set, only
+ * pairs (i, j) with i before j in Morton order are expected */
+static void
+check_csr(const SampleStruct *sp, const CSR *csr, double r_sq, int half)
+{
+    size_t i, j, num, *pos;
+    const Value *q;
+    uint8_t *found  = xmalloc( sp->s );
+
+    /* Morton position of each original index */
+    pos = xmalloc( sizeof(size_t) * sp->s );
+    for ( i = 0; i < sp->s; ++i )
+        pos[sp->i[i].idx] = i;
+
+    assert_size(csr->n, ==, sp->s);
+    for ( i = 0; i < sp->s; ++i ) {
+        q = &sp->v[i];
+        for ( j = 0; j < sp->s; ++j )
+            found[j] = 0;
+        for ( j = csr->offsets[i]; j < csr->offsets[i+1]; ++j ) {
+            assert_size(csr->indices[j], !=, i);
+            assert_double(METRIC(q, &sp->v[csr->indices[j]]), <, r_sq);
+            assert_uint8(found[csr->indices[j]]++, ==, 0);
+            if ( half )
+                assert_size(pos[i], <, pos[csr->indices[j]]);
+        }
+        for ( num = 0, j = 0; j < sp->s; ++j )
+            if ( j != i && METRIC(q, &sp->v[j]) < r_sq
+                    && (!half || pos[i] < pos[j]) )
+                ++num;
+        assert_size(csr->offsets[i+1] - csr->offsets[i], ==, num);
+    }
+
+    free(pos);
+    free(found);
+}
+
+
+static MunitResult
+test_pairs_radius(const MunitParameter params[], void *data)
+{
+    double r_sq         = atof(munit_parameters_get(params, "r_sq"));
+    int half            = atoi(munit_parameters_get(params, "half"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    CSR csr;
+
+    pairs_radius( sp->h, sp->i, sp->s, r_sq, half, &csr );
+    check_csr( sp, &csr, r_sq, half );
+    csr_free( &csr );
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_pairs_dualtree(const MunitParameter params[], void *data)
+{
+    double r_sq         = atof(munit_parameters_get(params, "r_sq"));
+    int half            = atoi(munit_parameters_get(params, "half"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    CSR csr;
+
+    pairs_dualtree( sp->h, sp->s, r_sq, half, &csr );
+    check_csr( sp, &csr, r_sq, half );
+    csr_free( &csr );
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_pairs_concurrent(const MunitParameter params[], void *data)
+{
+    double r_sq         = atof(munit_parameters_get(params, "r_sq"));
+    int half            = atoi(munit_parameters_get(params, "half"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    CSR csr;
+
+    pairs_radius_concurrent( sp->h, sp->i, sp->s, r_sq, half, 8, &csr );
+    check_csr( sp, &csr, r_sq, half );
+    csr_free( &csr );
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_pairs_verlet(const MunitParameter params[], void *data)
+{
+    (void) params;
+
+    size_t i, step, nsteps = 40;
+    int dx, dy;
+    SampleStruct *sp    = (SampleStruct *)data;
+    uint8_t *occupied   = xmalloc( 1 << 16 );
+    double r            = 6, skin = 4;
+    verlet_t v;
+    CSR csr;
+
+    for ( i = 0; i < (1 << 16); ++i )
+        occupied[i] = 0;
+    for ( i = 0; i < sp->s; ++i )
+        occupied[sp->v[i].x << 8 | sp->v[i].y] = 1;
+
+    verlet_init( &v, sp->v, sp->s, r, skin );
+    for ( step = 0; step < nsteps; ++step ) {
+        /* random walk by at most one in each direction, values stay unique */
+        for ( i = 0; i < sp->s; ++i ) {
+            dx = munit_rand_int_range(-1, 1);
+            dy = munit_rand_int_range(-1, 1);
+            if ( sp->v[i].x + dx < 0 || sp->v[i].x + dx > 255
+                    || sp->v[i].y + dy < 0 || sp->v[i].y + dy > 255
+                    || occupied[(sp->v[i].x + dx) << 8 | (sp->v[i].y + dy)] )
+                continue;
+            occupied[sp->v[i].x << 8 | sp->v[i].y] = 0;
+            sp->v[i].x += dx;
+            sp->v[i].y += dy;
+            occupied[sp->v[i].x << 8 | sp->v[i].y] = 1;
+        }
+        verlet_update( &v );
+        verlet_pairs( &v, &csr );
+        check_csr( sp, &csr, SQUARE(r), 0 );
+        csr_free( &csr );
+    }
+    /* the list is reused over several steps */
+    assert_size(v.builds, >, 1);
+    assert_size(v.builds, <, nsteps);
+
+    verlet_free( &v );
+    free(occupied);
+
+    return MUNIT_OK;
+}
+
+
+/*********************************************************************/
+
+
+/***********/
+/* GRAVITY */
+/***********/
+
+/* rel_error
+ * root mean square error of the approximation (ax, ay) of the accelerations
+ * (ex, ey), relative to their root mean square */
+static double
+rel_error(const double *ax, const double *ay, const double *ex,
+          const double *ey, size_t size)
+{
+    size_t i;
+    double err = 0, norm = 0;
+
+    for ( i = 0; i < size; ++i ) {
+        err    += SQUARE(ax[i] - ex[i]) + SQUARE(ay[i] - ey[i]);
+        norm   += SQUARE(ex[i]) + SQUARE(ey[i]);
+    }
+
+    return sqrt(err / norm);
+}
+
+
+static MunitResult
+test_gravity_bh(const MunitParameter params[], void *data)
+{
+    size_t i;
+    double theta        = atof(munit_parameters_get(params, "theta"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    double *mass        = xmalloc( sizeof(double) * sp->s );
+    double *a           = xmalloc( sizeof(double) * 4 * sp->s );
+    double *ax = a, *ay = a + sp->s, *ex = a + 2*sp->s, *ey = a + 3*sp->s;
+    double err;
+    bh_t bh;
+
+    for ( i = 0; i < sp->s; ++i )
+        mass[i] = 1 + i % 3;
+    direct_accel( sp->v, mass, sp->s, 1.0, ex, ey );
+
+    bh_init( &bh, sp->h, mass );
+    assert_size(bh.ncells, <=, MAXLVL * sp->s + 1);
+    bh_accel( &bh, sp->i, sp->s, theta, 1.0, 4, ax, ay );
+    err = rel_error( ax, ay, ex, ey, sp->s );
+    /* exact for theta = 0, the error of monopoles grows with theta^2 */
+    if ( theta == 0 )
+        assert_double(err, <, 1e-12);
+    else
+        assert_double(err, <, 0.1 * theta * theta);
+
+    /* moments follow the values after refit (mirrored, so still unique) */
+    for ( i = 0; i < sp->s; ++i )
+        sp->v[i].x = 255 - sp->v[i].x;
+    refit( sp->h, sp->i, NULL );
+    bh_update( &bh );
+    direct_accel( sp->v, mass, sp->s, 1.0, ex, ey );
+    bh_accel( &bh, sp->i, sp->s, theta, 1.0, 4, ax, ay );
+    err = rel_error( ax, ay, ex, ey, sp->s );
+    if ( theta == 0 )
+        assert_double(err, <, 1e-12);
+    else
+        assert_double(err, <, 0.1 * theta * theta);
+    bh_free( &bh );
+
+    free(mass);
+    free(a);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_gravity_fmm(const MunitParameter params[], void *data)
+{
+    size_t i;
+    unsigned int order  = atoi(munit_parameters_get(params, "order"));
+    size_t leaf         = atoi(munit_parameters_get(params, "leaf"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    double *mass        = xmalloc( sizeof(double) * sp->s );
+    double *a           = xmalloc( sizeof(double) * 4 * sp->s );
+    double *ax = a, *ay = a + sp->s, *ex = a + 2*sp->s, *ey = a + 3*sp->s;
+    fmm_t f;
+
+    for ( i = 0; i < sp->s; ++i )
+        mass[i] = 1 + i % 3;
+    direct_accel_log( sp->v, mass, sp->s, ex, ey );
+
+    fmm_init( &f, sp->h, mass, order, leaf );
+    assert_size(f.size, ==, sp->s);
+    for ( i = 0; i < f.ncells; ++i )
+        if ( f.cells[i].e - f.cells[i].b > leaf )
+            assert_size(f.cells[i].c[0] + f.cells[i].c[1] + f.cells[i].c[2]
+                        + f.cells[i].c[3], >, 0);
+    fmm_accel( &f, 4, ax, ay );
+    /* the error decreases geometrically with the order */
+    assert_double(rel_error( ax, ay, ex, ey, sp->s ), <, pow(0.4, order));
+    fmm_free( &f );
+
+    free(mass);
+    free(a);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_gravity_fmm_clustered(const MunitParameter params[], void *data)
+{
+    (void) data;
+
+    size_t i, j, size = 2000;
+    unsigned int order  = atoi(munit_parameters_get(params, "order"));
+    size_t leaf         = atoi(munit_parameters_get(params, "leaf"));
+    uint8_t *seen       = xmalloc( 256 * 256 );
+    Value *vals         = xmalloc( sizeof(Value) * size );
+    Item *items         = xmalloc( sizeof(Item) * size );
+    double *a           = xmalloc( sizeof(double) * 4 * size );
+    double *ax = a, *ay = a + size, *ex = a + 2*size, *ey = a + 3*size;
+    double r, phi;
+    int x, y;
+    Node *head;
+    fmm_t f;
+
+    for ( i = 0; i < 256 * 256; ++i )
+        seen[i] = 0;
+    /* four clusters, whose density falls off steeply from their centres,
+     * so the tree is deep there and shallow in between */
+    for ( i = 0; i < size; ) {
+        j   = munit_rand_int_range(0, 3);
+        r   = pow(munit_rand_double(), 3) * 60;
+        phi = munit_rand_double() * 6.283185307179586;
+        x   = 64 + 128 * (j & 1) + (int)(r * cos(phi));
+        y   = 64 + 128 * (j >> 1) + (int)(r * sin(phi));
+        if ( x < 0 || x > 255 || y < 0 || y > 255 || seen[256*y + x] )
+            continue;
+        seen[256*y + x] = 1;
+        vals[i].x = x;
+        vals[i].y = y;
+        ++i;
+    }
+    build_morton( vals, items, size );
+    head = build_tree( items, insert_fast );
+    direct_accel_log( vals, NULL, size, ex, ey );
+
+    fmm_init( &f, head, NULL, order, leaf );
+    fmm_accel( &f, 4, ax, ay );
+    assert_double(rel_error( ax, ay, ex, ey, size ), <, pow(0.4, order));
+    fmm_free( &f );
+
+    cleanup(head);
+    free(a);
+    free(items);
+    free(vals);
+    free(seen);
+
+    return MUNIT_OK;
+}
+
+
+/*********************************************************************/
+
+
+/*******/
+/* SPH */
+/*******/
+
+static MunitResult
+test_sph_sums(const MunitParameter params[], void *data)
+{
+    size_t i, j;
+    sph_kernel_t kernel = strcmp(munit_parameters_get(params, "kernel"),
+                                 "cubic") ? SPH_WENDLAND : SPH_CUBIC;
+    SampleStruct *sp    = (SampleStruct *)data;
+    double *buf         = xmalloc( sizeof(double) * 6 * sp->s );
+    double *mass = buf, *h = buf + sp->s, *rho = buf + 2*sp->s;
+    double *ax = buf + 3*sp->s, *ay = buf + 4*sp->s, *p = buf + 5*sp->s;
+    double r, e, f, ex, ey, px = 0, py = 0, norm = 0;
+    const Value *vi, *vj;
+    sph_t s;
+
+    /* arrays are in Morton order */
+    for ( i = 0; i < sp->s; ++i ) {
+        mass[i] = 1 + i % 3;
+        h[i]    = 2 + i % 5;
+    }
+    sph_init( &s, sp->h, sp->i, sp->s, kernel, mass, h );
+    sph_density( &s, 4, rho );
+    for ( i = 0; i < sp->s; ++i )
+        p[i] = rho[i];      /* isothermal, sound speed 1 */
+    sph_accel( &s, rho, p, 4, ax, ay );
+
+    /* compare with direct sums over all pairs */
+    for ( i = 0; i < sp->s; ++i ) {
+        vi = sp->i[i].val;
+        e = ex = ey = 0;
+        for ( j = 0; j < sp->s; ++j ) {
+            vj  = sp->i[j].val;
+            r   = sqrt(METRIC(vi, vj));
+            e  += mass[j] * sph_w( kernel, r, h[i] );
+            if ( j == i )
+                continue;
+            f   = mass[j] * (p[i] / SQUARE(rho[i]) + p[j] / SQUARE(rho[j]))
+                * sph_dw( kernel, r, (h[i] + h[j]) / 2 ) / r;
+            ex -= f * (vi->x - vj->x);
+            ey -= f * (vi->y - vj->y);
+        }
+        assert_double_equal(rho[i], e, 9);
+        assert_double_equal(ax[i], ex, 9);
+        assert_double_equal(ay[i], ey, 9);
+        px     += mass[i] * ax[i];
+        py     += mass[i] * ay[i];
+        norm   += mass[i] * sqrt(SQUARE(ax[i]) + SQUARE(ay[i]));
+    }
+    /* pairwise forces are antisymmetric: momentum is conserved */
+    assert_double(fabs(px) + fabs(py), <, 1e-12 * norm);
+
+    free(buf);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_sph_lattice(const MunitParameter params[], void *data)
+{
+    (void) data;
+
+    size_t i, n = 32, size = n * n;
+    sph_kernel_t kernel = strcmp(munit_parameters_get(params, "kernel"),
+                                 "cubic") ? SPH_WENDLAND : SPH_CUBIC;
+    Value *vals         = xmalloc( sizeof(Value) * size );
+    Item *items         = xmalloc( sizeof(Item) * size );
+    double *buf         = xmalloc( sizeof(double) * 3 * size );
+    double *mass = buf, *h = buf + size, *rho = buf + 2*size;
+    Node *head;
+    sph_t s;
+
+    /* unit lattice with unit masses has density 1 */
+    for ( i = 0; i < size; ++i ) {
+        vals[i].x = 100 + i % n;
+        vals[i].y = 100 + i / n;
+        mass[i] = 1;
+        h[i]    = 1.7;
+    }
+    build_morton( vals, items, size );
+    head = build_tree( items, insert_fast );
+    sph_init( &s, head, items, size, kernel, mass, h );
+    sph_density( &s, 2, rho );
+    for ( i = 0; i < size; ++i )
+        if ( items[i].val->x >= 104 && items[i].val->x < 100 + n - 4
+                && items[i].val->y >= 104 && items[i].val->y < 100 + n - 4 )
+            assert_double(fabs(rho[i] - 1), <, 0.02);
+
+    cleanup(head);
+    free(buf);
+    free(items);
+    free(vals);
+
+    return MUNIT_OK;
+}
+
+
+/*********************************************************************/
+
+
+/***********/
+/* CLUSTER */
+/***********/
+
+/* components
+ * label connected components of the graph of the values closer than b to
+ * each other by depth-first search; only values with use[i] != 0 (all, if
+ * use is NULL) are part of the graph, the others are labelled
+ * CLUSTER_NOISE */
+static size_t
+components(const Value *v, size_t size, double b, const uint8_t *use,
+           size_t *labels)
+{
+    size_t i, j, k, top, num = 0;
+    size_t *stack = xmalloc( sizeof(size_t) * size );
+
+    for ( i = 0; i < size; ++i )
+        labels[i] = CLUSTER_NOISE;
+    for ( i = 0; i < size; ++i ) {
+        if ( labels[i] != CLUSTER_NOISE || (use && !use[i]) )
+            continue;
+        labels[i]   = num;
+        stack[0]    = i;
+        top         = 1;
+        while ( top ) {
+            k = stack[--top];
+            for ( j = 0; j < size; ++j ) {
+                if ( labels[j] != CLUSTER_NOISE || (use && !use[j])
+                        || METRIC(&v[k], &v[j]) >= b * b )
+                    continue;
+                labels[j]       = num;
+                stack[top++]    = j;
+            }
+        }
+        ++num;
+    }
+    free(stack);
+
+    return num;
+}
+
+
+static MunitResult
+test_cluster_fof(const MunitParameter params[], void *data)
+{
+    size_t i, num;
+    double b            = atof(munit_parameters_get(params, "b"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    size_t *labels      = xmalloc( sizeof(size_t) * sp->s );
+    size_t *ref         = xmalloc( sizeof(size_t) * sp->s );
+
+    /* components are numbered in the order of their first value as well */
+    num = components( sp->v, sp->s, b, NULL, ref );
+    assert_size(cluster_fof( sp->h, sp->i, sp->s, b, 4, labels ), ==, num);
+    for ( i = 0; i < sp->s; ++i )
+        assert_size(labels[i], ==, ref[i]);
+    assert_size(cluster_fof( sp->h, sp->i, sp->s, b, 1, labels ), ==, num);
+    for ( i = 0; i < sp->s; ++i )
+        assert_size(labels[i], ==, ref[i]);
+
+    free(labels);
+    free(ref);
+
+    return MUNIT_OK;
+}
+
+
+static MunitResult
+test_cluster_dbscan(const MunitParameter params[], void *data)
+{
+    size_t i, j, num, cnt;
+    double b            = atof(munit_parameters_get(params, "b"));
+    size_t minpts       = atoi(munit_parameters_get(params, "minpts"));
+    SampleStruct *sp    = (SampleStruct *)data;
+    size_t *labels      = xmalloc( sizeof(size_t) * sp->s );
+    size_t *ref         = xmalloc( sizeof(size_t) * sp->s );
+    size_t *map         = xmalloc( sizeof(size_t) * sp->s );
+    uint8_t *core       = xmalloc( sp->s );
+
+    for ( i = 0; i < sp->s; ++i ) {
+        for ( j = 0, cnt = 0; j < sp->s; ++j )
+            cnt += METRIC(&sp->v[i], &sp->v[j]) < b * b;
+        core[i] = cnt >= minpts;
+        map[i]  = CLUSTER_NOISE;
+    }
+    num = components( sp->v, sp->s, b, core, ref );
+    assert_size(cluster_dbscan( sp->h, sp->i, sp->s, b, minpts, 4, labels ),
+                ==, num);
+
+    for ( i = 0; i < sp->s; ++i ) {
+        if ( core[i] ) {
+            /* clusters of core values are the same up to their numbering */
+            if ( map[labels[i]] == CLUSTER_NOISE )
+                map[labels[i]] = ref[i];
+            assert_size(map[labels[i]], ==, ref[i]);
+            continue;
+        }
+        /* border values join the cluster of a core value within b */
+        for ( j = 0; j < sp->s; ++j )
+            if ( core[j] && METRIC(&sp->v[i], &sp->v[j]) < b * b
+                    && labels[j] == labels[i] )
+                break;
+        if ( labels[i] == CLUSTER_NOISE ) {
+            for ( j = 0; j < sp->s; ++j )
+                assert_false(core[j] && METRIC(&sp->v[i], &sp->v[j]) < b * b);
+        } else {
+            assert_size(j, <, sp->s);
+        }
+    }
+
+    free(labels);
+    free(ref);
+    free(map);
+    free(core);
+
+    return MUNIT_OK;
+}
+
+
 /*********************************************************************/
 
 
@@ -228,6 +1517,66 @@ MunitTest tests[] = {
     { "/test_quadtree_neighbours", test_quadtree_neighbours, quadtree_setup,
         quadtree_teardown, MUNIT_TEST_OPTION_NONE, quadtree_neighbours_params_2 },
 
+    { "/test_quadtree_refit", test_quadtree_refit, NULL, NULL,
+        MUNIT_TEST_OPTION_NONE, NULL },
+    { "/test_quadtree_concurrent", test_quadtree_concurrent, NULL, NULL,
+        MUNIT_TEST_OPTION_NONE, NULL },
+    { "/test_quadtree_root", test_quadtree_root, NULL, NULL,
+        MUNIT_TEST_OPTION_NONE, NULL },
+    { "/test_quadtree_periodic", test_quadtree_periodic, NULL, NULL,
+        MUNIT_TEST_OPTION_NONE, NULL },
+
+    { "/test_query_path", test_query_path, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, NULL },
+    { "/test_query_leaf", test_query_leaf, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, NULL },
+    { "/test_query_point", test_query_point, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, NULL },
+    { "/test_query_filter", test_query_filter, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, query_radius_params },
+    { "/test_query_ring", test_query_ring, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, query_ring_params },
+    { "/test_query_range", test_query_range, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, NULL },
+    { "/test_query_radius", test_query_radius, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, query_radius_params },
+    { "/test_query_count", test_query_count, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, query_radius_params },
+    { "/test_query_visit", test_query_visit, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, query_radius_params },
+
+    { "/test_query_knn", test_query_knn, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, query_knn_params },
+    { "/test_query_ann", test_query_ann, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, query_ann_params },
+
+    { "/test_pairs_radius", test_pairs_radius, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, pairs_params },
+
+    { "/test_pairs_dualtree", test_pairs_dualtree, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, pairs_params },
+    { "/test_pairs_concurrent", test_pairs_concurrent, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, pairs_params },
+    { "/test_pairs_verlet", test_pairs_verlet, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, NULL },
+
+    { "/test_gravity_bh", test_gravity_bh, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, gravity_bh_params },
+    { "/test_gravity_fmm", test_gravity_fmm, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, gravity_fmm_params },
+    { "/test_gravity_fmm_clustered", test_gravity_fmm_clustered, NULL, NULL,
+        MUNIT_TEST_OPTION_NONE, gravity_fmm_params },
+
+    { "/test_sph_sums", test_sph_sums, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, sph_params },
+    { "/test_sph_lattice", test_sph_lattice, NULL, NULL,
+        MUNIT_TEST_OPTION_NONE, sph_params },
+
+    { "/test_cluster_fof", test_cluster_fof, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, cluster_fof_params },
+    { "/test_cluster_dbscan", test_cluster_dbscan, sample_setup,
+        sample_teardown, MUNIT_TEST_OPTION_NONE, cluster_dbscan_params },
+
     { NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL }
 };
 
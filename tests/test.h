@@ -1,10 +1,20 @@
 #pragma once
 
 #include <stdio.h>
+#include <math.h>
 #define MUNIT_ENABLE_ASSERT_ALIASES
 #include "munit.h"
 #include "../include/morton.h"
 #include "../include/quadtree.h"
+#include "../include/query.h"
+#include "../include/pairs.h"
+#include "../include/filter.h"
+#include "../include/verlet.h"
+#include "../include/visit.h"
+#include "../include/gravity.h"
+#include "../include/fmm.h"
+#include "../include/sph.h"
+#include "../include/cluster.h"
 
 
 typedef struct {
@@ -19,5 +29,9 @@ typedef struct {
     key_t key; key_t *val;
 } KeyValueInput;
 
+typedef struct {
+    Value *v; Item *i; Node *h; size_t s;
+} SampleStruct;
+
 
 /* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
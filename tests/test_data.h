@@ -1,5 +1,6 @@
 #pragma once
 #include "test.h"
+#include "sample_data.h"
 
 
 #define __any_values_1_size 16u
@@ -288,4 +289,157 @@ static MunitParameterEnum quadtree_neighbours_params_2[] = {
     { NULL, NULL }
 };
 
+/*********************************************************************/
+/*********************************************************************/
+/*********************************************************************/
+
+
+/*********/
+/* QUERY */
+/*********/
+
+/* squared radii, from less than a leaf up to the whole domain */
+static char *query_radius_input[] = {
+    "1", "16", "100", "2000", "70000",
+    NULL
+};
+
+static MunitParameterEnum query_radius_params[] = {
+    { "r_sq", query_radius_input },
+    { NULL, NULL }
+};
+
+
+static char *query_knn_input[] = {
+    "1", "4", "16",
+    NULL
+};
+
+static MunitParameterEnum query_knn_params[] = {
+    { "k", query_knn_input },
+    { NULL, NULL }
+};
+
+
+static char *query_eps_input[] = {
+    "0", "0.5", "2",
+    NULL
+};
+
+static char *query_leaves_input[] = {
+    "0", "4", "32",
+    NULL
+};
+
+static MunitParameterEnum query_ann_params[] = {
+    { "k", query_knn_input },
+    { "eps", query_eps_input },
+    { "leaves", query_leaves_input },
+    { NULL, NULL }
+};
+
+
+static char *query_rings_input[] = {
+    "1", "2", "5",
+    NULL
+};
+
+static MunitParameterEnum query_ring_params[] = {
+    { "r_sq", query_radius_input },
+    { "rings", query_rings_input },
+    { NULL, NULL }
+};
+
+
+/*********************************************************************/
+/*********************************************************************/
+
+/*********/
+/* PAIRS */
+/*********/
+
+static char *pairs_half_input[] = {
+    "0", "1",
+    NULL
+};
+
+static MunitParameterEnum pairs_params[] = {
+    { "r_sq", query_radius_input },
+    { "half", pairs_half_input },
+    { NULL, NULL }
+};
+
+
+/***********/
+/* GRAVITY */
+/***********/
+
+static char *gravity_theta_input[] = {
+    "0", "0.3", "0.5", "0.8",
+    NULL
+};
+
+static MunitParameterEnum gravity_bh_params[] = {
+    { "theta", gravity_theta_input },
+    { NULL, NULL }
+};
+
+static char *gravity_order_input[] = {
+    "2", "4", "8", "16",
+    NULL
+};
+
+static char *gravity_leaf_input[] = {
+    "1", "8", "32",
+    NULL
+};
+
+static MunitParameterEnum gravity_fmm_params[] = {
+    { "order", gravity_order_input },
+    { "leaf", gravity_leaf_input },
+    { NULL, NULL }
+};
+
+
+/*******/
+/* SPH */
+/*******/
+
+static char *sph_kernel_input[] = {
+    "cubic", "wendland",
+    NULL
+};
+
+static MunitParameterEnum sph_params[] = {
+    { "kernel", sph_kernel_input },
+    { NULL, NULL }
+};
+
+
+/***********/
+/* CLUSTER */
+/***********/
+
+static char *cluster_b_input[] = {
+    "1.5", "3", "6",
+    NULL
+};
+
+static char *cluster_minpts_input[] = {
+    "1", "4", "8",
+    NULL
+};
+
+static MunitParameterEnum cluster_fof_params[] = {
+    { "b", cluster_b_input },
+    { NULL, NULL }
+};
+
+static MunitParameterEnum cluster_dbscan_params[] = {
+    { "b", cluster_b_input },
+    { "minpts", cluster_minpts_input },
+    { NULL, NULL }
+};
+
+
 /* vim: set ff=unix tw=79 sw=4 ts=4 et ic ai : */
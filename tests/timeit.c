@@ -5,8 +5,6 @@
  * sanity-checks, i.e. obeys the 16-bit-key-boundaries).
  * the results in nano seconds are printed to stdout.
  *
- * TODO: integer overflow might occure, perhaps print also seconds
- *
  * REQUIRES POSIX
  *
  */
@@ -28,6 +26,13 @@
 #include "sample_data.h"
 
 
+/* nano seconds from a to b, also across full seconds */
+static long elapsed(const struct timespec *a, const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * 1000000000L + (b->tv_nsec - a->tv_nsec);
+}
+
+
 void timeit(int(*func)(const fargs_t *), const fargs_t *fargs,
             unsigned int iter, char *name)
 {
@@ -44,7 +49,7 @@ void timeit(int(*func)(const fargs_t *), const fargs_t *fargs,
         (*func)(fargs);
         clock_gettime(CLOCK_REALTIME, &tp_c);
 
-        res[i] = tp_c.tv_nsec - tp_b.tv_nsec;
+        res[i] = elapsed(&tp_b, &tp_c);
         avg += (double) res[i];
         if ( res[i] < min )
             min = res[i];
@@ -61,14 +66,96 @@ void timeit(int(*func)(const fargs_t *), const fargs_t *fargs,
 
     printf("\nTIMEIT %s - %u runs\n"        \
            "average     :   %lf +- %lf ns\n"\
-           "    max/min :   %lu / %lu\n"    \
-           "total time  :   %lu ns\n\n",
-           name, iter, avg, std, max, min, tp_c.tv_nsec - tp_a.tv_nsec);
+           "    max/min :   %ld / %ld\n"    \
+           "total time  :   %ld ns\n\n",
+           name, iter, avg, std, max, min, elapsed(&tp_a, &tp_c));
 
     free(res);
 }
 
 
+/* size unique random values (x, y interleaved), either uniform or in four
+ * clusters, whose density falls off steeply from their centres; free the
+ * result */
+unsigned int *random_data(size_t size, int clustered)
+{
+    size_t i;
+    int j, x, y;
+    double r, phi;
+    unsigned int *data = xmalloc(sizeof(unsigned int) * 2 * size);
+    uint8_t *seen = xmalloc(256 * 256);
+
+    for ( i = 0; i < 256 * 256; ++i )
+        seen[i] = 0;
+    srand(1265);
+    for ( i = 0; i < size; ) {
+        if ( clustered ) {
+            j   = rand() % 4;
+            r   = pow((double)rand() / RAND_MAX, 3) * 60;
+            phi = (double)rand() / RAND_MAX * 6.283185307179586;
+            x   = 64 + 128 * (j & 1) + (int)(r * cos(phi));
+            y   = 64 + 128 * (j >> 1) + (int)(r * sin(phi));
+        } else {
+            x   = rand() % 256;
+            y   = rand() % 256;
+        }
+        if ( x < 0 || x > 255 || y < 0 || y > 255 || seen[256*y + x] )
+            continue;
+        seen[256*y + x] = 1;
+        data[2*i]   = x;
+        data[2*i+1] = y;
+        ++i;
+    }
+
+    free(seen);
+    return data;
+}
+
+
+/* rms error of fmm_accel relative to direct_accel_log (the same potential)
+ * for several orders and leaf sizes */
+void fmm_accuracy(const unsigned int *data, size_t size, char *name)
+{
+    size_t i, leaf;
+    unsigned int order;
+    double err, norm;
+    Value *vals = xmalloc(sizeof(Value) * size);
+    Item *items = xmalloc(sizeof(Item) * size);
+    double *a   = xmalloc(sizeof(double) * 4 * size);
+    double *ax = a, *ay = a + size, *ex = a + 2*size, *ey = a + 3*size;
+    Node *head;
+    fmm_t fmm;
+
+    for ( i = 0; i < size; ++i ) {
+        vals[i].x = data[2*i];
+        vals[i].y = data[2*i+1];
+    }
+    build_morton(vals, items, size);
+    head = build_tree(items, insert_fast);
+    direct_accel_log(vals, NULL, size, ex, ey);
+
+    printf("\nACCURACY fmm - %s\n", name);
+    for ( leaf = 4; leaf <= 64; leaf *= 4 ) {
+        for ( order = 2; order <= 24; order += 2 ) {
+            fmm_init(&fmm, head, NULL, order, leaf);
+            fmm_accel(&fmm, 1, ax, ay);
+            for ( i = 0, err = 0, norm = 0; i < size; ++i ) {
+                err    += SQUARE(ax[i] - ex[i]) + SQUARE(ay[i] - ey[i]);
+                norm   += SQUARE(ex[i]) + SQUARE(ey[i]);
+            }
+            printf("leaf %2zu, order %2u    :   %e\n", leaf, order,
+                   sqrt(err / norm));
+            fmm_free(&fmm);
+        }
+    }
+
+    cleanup(head);
+    free(a);
+    free(items);
+    free(vals);
+}
+
+
 int main()
 {
     unsigned int iter = 100u;
@@ -76,11 +163,71 @@ int main()
     timeit(search_naive, &fargs_small, iter, "naive - 256");
     timeit(search_fast, &fargs_small, iter, "fast - 256");
     timeit(search_fastfast, &fargs_small, iter, "fastfast - 256");
+    timeit(search_fastpath, &fargs_small, iter, "fastpath - 256");
+    timeit(search_fastleaf, &fargs_small, iter, "fastleaf - 256");
+    timeit(search_fastsimd, &fargs_small, iter, "fastsimd - 256");
+    timeit(search_periodic, &fargs_small, iter, "periodic - 256");
+    timeit(search_ring, &fargs_small, iter, "ring - 256");
+    timeit(search_radius, &fargs_small, iter, "radius - 256");
+    timeit(search_count, &fargs_small, iter, "count - 256");
+    timeit(search_visit, &fargs_small, iter, "visit - 256");
+    timeit(search_pairs, &fargs_small, iter, "pairs - 256");
+    timeit(search_dualtree, &fargs_small, iter, "dualtree - 256");
+    timeit(search_pairs_half, &fargs_small, iter, "pairs_half - 256");
+    timeit(search_dualtree_half, &fargs_small, iter, "dualtree_half - 256");
+    timeit(search_pairs_concurrent, &fargs_small, iter,
+            "pairs_concurrent - 256");
 
     const fargs_t fargs = { .data=input_data_1265, .size=size_1265, .r_sq=16.0f };
     timeit(search_naive, &fargs, iter, "naive - 1265");
     timeit(search_fast, &fargs, iter, "fast - 1265");
     timeit(search_fastfast, &fargs, iter, "fastfast - 1265");
+    timeit(search_fastpath, &fargs, iter, "fastpath - 1265");
+    timeit(search_fastleaf, &fargs, iter, "fastleaf - 1265");
+    timeit(search_fastsimd, &fargs, iter, "fastsimd - 1265");
+    timeit(search_periodic, &fargs, iter, "periodic - 1265");
+    timeit(search_ring, &fargs, iter, "ring - 1265");
+    timeit(search_radius, &fargs, iter, "radius - 1265");
+    timeit(search_count, &fargs, iter, "count - 1265");
+    timeit(search_visit, &fargs, iter, "visit - 1265");
+    timeit(search_pairs, &fargs, iter, "pairs - 1265");
+    timeit(search_dualtree, &fargs, iter, "dualtree - 1265");
+    timeit(search_pairs_half, &fargs, iter, "pairs_half - 1265");
+    timeit(search_dualtree_half, &fargs, iter, "dualtree_half - 1265");
+    timeit(search_pairs_concurrent, &fargs, iter, "pairs_concurrent - 1265");
+    /* bh and fmm solve different potentials, each is timed against its own
+     * direct summation */
+    timeit(search_direct, &fargs, iter, "direct - 1265");
+    timeit(search_bh, &fargs, iter, "bh - 1265");
+    timeit(search_direct_log, &fargs, iter, "direct_log - 1265");
+    timeit(search_fmm, &fargs, iter, "fmm - 1265");
+
+    unsigned int *clustered = random_data(size_1265, 1);
+    const fargs_t fargs_clustered = { .data=clustered, .size=size_1265,
+        .r_sq=16.0f };
+    timeit(search_direct_log, &fargs_clustered, iter,
+            "direct_log - 1265 clustered");
+    timeit(search_fmm, &fargs_clustered, iter, "fmm - 1265 clustered");
+
+    fmm_accuracy(input_data_1265, size_1265, "1265");
+    fmm_accuracy(clustered, size_1265, "1265 clustered");
+    free(clustered);
+
+    /* find_neighbours alone on sparse and dense inputs; 60000 values fill
+     * most of the 256 x 256 grid */
+    const struct { size_t size; int clustered; unsigned int iter; char *name; }
+    nb[] = {
+        { 500, 0, 100, "neighbours - 500 uniform" },
+        { 4000, 1, 100, "neighbours - 4000 clustered" },
+        { 20000, 0, 20, "neighbours - 20000 uniform" },
+        { 60000, 0, 20, "neighbours - 60000 uniform" },
+    };
+    for ( size_t k = 0; k < sizeof(nb) / sizeof(nb[0]); ++k ) {
+        unsigned int *data = random_data(nb[k].size, nb[k].clustered);
+        const fargs_t fargs_nb = { .data=data, .size=nb[k].size, .r_sq=16.0f };
+        timeit(search_neighbours, &fargs_nb, nb[k].iter, nb[k].name);
+        free(data);
+    }
     return 0;
 }
 